@@ -0,0 +1,261 @@
+// Static recompiler: translates the PRG-ROM code reachable from the interrupt
+// vectors of an iNES file into a C++ translation unit of basic block functions,
+// to be linked with a core built with NOS_CPU_AOT (see CPU::Compiled_Block).
+// Code which is not discovered here (e.g. reached through JMP (ind) or RTS
+// tables, or running from RAM) is left to the interpreter.
+
+#include <cstdint>      // uint8_t, uint16_t
+#include <cstdio>       // snprintf
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>       // unique_ptr
+#include <string>
+#include <vector>
+
+#include "console.h"
+#include "ines.h"
+
+using namespace NES;
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace
+{
+
+
+struct Opcode_Names
+{
+    const char* instr;
+    const char* addr_mode;
+};
+
+// Indexed by opcode
+constexpr Opcode_Names opcode_names[0x100] =
+{
+#define NOS_OPCODE_NAMES(code, i, am) { #i, #am },
+    NOS_OPCODE_MAP(NOS_OPCODE_NAMES)
+#undef NOS_OPCODE_NAMES
+};
+
+
+struct Block
+{
+    uint16_t addr;
+    vector<Decoded_Instr> instrs;
+};
+
+class Disassembler
+{
+  private:
+    Shared_Bus& shared_bus;
+
+    // Precondition: addr lies in PRG-ROM
+    uint8_t read(uint16_t addr)
+    {
+        return shared_bus.cpu_page_read[addr >> 8][addr % 0x100];
+    }
+
+    bool is_rom(uint16_t addr)
+    {
+        return (shared_bus.cpu_page_read[addr >> 8] &&
+                !shared_bus.cpu_page_write[addr >> 8]);
+    }
+
+    // Same block boundaries as the JIT: up to and including the first control
+    // flow instruction, without crossing into the next page
+    Block decode_block(uint16_t addr)
+    {
+        Block block = { addr, {} };
+        while(true)
+        {
+            uint8_t page_addr = addr % 0x100;
+            const Opcode_Info& info = opcode_info[read(addr)];
+            unsigned int size = 1 + operand_size(info.addr_mode);
+
+            if(page_addr + size > 0x100) break;
+
+            Decoded_Instr decoded = {};
+            for(unsigned int k = 0; k < size; ++k)
+                decoded.bytes[k] = read(addr + k);
+            block.instrs.push_back(decoded);
+
+            if(is_control_flow(info.instr) || (page_addr + size == 0x100))
+                break;
+            addr += size;
+        }
+
+        return block;
+    }
+
+    vector<uint16_t> get_successors(const Block& block)
+    {
+        uint16_t addr = block.addr;
+        for(size_t k = 0; k + 1 < block.instrs.size(); ++k)
+        {
+            uint8_t opcode = block.instrs[k].bytes[0];
+            addr += 1 + operand_size(opcode_info[opcode].addr_mode);
+        }
+
+        const uint8_t* bytes = block.instrs.back().bytes;
+        const Opcode_Info& info = opcode_info[bytes[0]];
+        uint16_t next = addr + 1 + operand_size(info.addr_mode);
+        uint16_t target = (bytes[2] << 8) | bytes[1];
+
+        switch(info.instr)
+        {
+            case(BCC): case(BCS): case(BEQ): case(BMI):
+            case(BNE): case(BPL): case(BVC): case(BVS):
+            {
+                int displacement = ((bytes[1] + 0x80) % 0x100) - 0x80;
+                return { next, uint16_t(next + displacement) };
+            }
+            // Assumes the subroutine returns
+            case(JSR): return { target, next };
+            case(JMP): return (info.addr_mode == Ab)
+                              ? vector<uint16_t>{ target }
+                              : vector<uint16_t>{};
+            case(RTS): case(RTI): case(BRK): case(STP):
+                return {};
+            // Block ended at a page boundary
+            default:   return { next };
+        }
+    }
+
+  public:
+    // Ordered by address, for a stable output
+    map<uint16_t, Block> blocks;
+
+    void trace(uint16_t entry)
+    {
+        vector<uint16_t> pending = { entry };
+        while(!pending.empty())
+        {
+            uint16_t addr = pending.back();
+            pending.pop_back();
+
+            if(!is_rom(addr) || blocks.count(addr))
+                continue;
+
+            Block block = decode_block(addr);
+            if(block.instrs.empty())
+                continue;
+
+            for(uint16_t successor : get_successors(block))
+                pending.push_back(successor);
+            blocks.emplace(addr, std::move(block));
+        }
+    }
+
+    uint16_t read_vector(uint16_t addr)
+    {
+        if(!is_rom(addr) || !is_rom(addr + 1))
+            return 0;
+        return (read(addr + 1) << 8) | read(addr);
+    }
+
+    Disassembler(Shared_Bus& shared_bus) : shared_bus(shared_bus) {}
+};
+
+
+string hex(unsigned int value, int digits)
+{
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%0*X", digits, value);
+    return buf;
+}
+
+void emit(std::ostream& out, const char* rom_filepath,
+          const map<uint16_t, Block>& blocks)
+{
+    out << "// Generated by nos-aot from " << rom_filepath << "\n"
+        << "// Build with the rest of the core and -DNOS_CPU_AOT\n\n"
+        << "#include \"console.h\"\n\n"
+        << "using namespace NES;\n\n"
+        << "namespace\n{\n\n";
+
+    for(const auto& [ addr, block ] : blocks)
+    {
+        string name = hex(addr, 4);
+
+        out << "// $" << name << "\n"
+            << "constexpr Decoded_Instr instrs_" << name << "[] =\n{\n";
+        for(const Decoded_Instr& instr : block.instrs)
+        {
+            const Opcode_Names& names = opcode_names[instr.bytes[0]];
+            out << "    {{ 0x" << hex(instr.bytes[0], 2)
+                << ", 0x" << hex(instr.bytes[1], 2)
+                << ", 0x" << hex(instr.bytes[2], 2) << " }},"
+                << "   // " << names.instr << " " << names.addr_mode << "\n";
+        }
+        out << "};\n\n";
+
+        out << "void block_" << name << "(CPU& cpu)\n{\n";
+        for(size_t k = 0; k < block.instrs.size(); ++k)
+        {
+            const Opcode_Names& names = opcode_names[block.instrs[k].bytes[0]];
+            bool is_last = (k + 1 == block.instrs.size());
+            string call = string("cpu.exec_decoded<") + names.instr + "," +
+                          names.addr_mode + ">(&instrs_" + name + "[" +
+                          std::to_string(k) + "])";
+
+            if(is_last) out << "    " << call << ";\n";
+            else        out << "    if(!" << call << ") return;\n";
+        }
+        out << "}\n\n";
+    }
+
+    out << "}\n\n"
+        << "extern const CPU::Compiled_Block aot_blocks[] =\n{\n";
+    for(const auto& [ addr, block ] : blocks)
+    {
+        string name = hex(addr, 4);
+        out << "    { 0x" << name << ", &block_" << name << ", instrs_" << name
+            << ", " << block.instrs.size() << " },\n";
+    }
+    if(blocks.empty())
+        out << "    { 0, nullptr, nullptr, 0 },\n";
+    out << "};\n\n"
+        << "extern const size_t aot_block_num = " << blocks.size() << ";\n";
+}
+
+
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 3)
+    {
+        std::cerr << "usage: nos-aot <rom> <output.cpp>\n";
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary | std::ios::in);
+    input >> std::noskipws;
+    vector<uint8_t> rom(std::istream_iterator<uint8_t>(input), {});
+
+    std::unique_ptr<Cartridge> cart = load_ines(rom);
+
+    // Only the page map is needed; code behind mapper handlers or in
+    // switchable banks other than those mapped on power-up is not discovered
+    Shared_Bus shared_bus;
+    cart->cpu_map_pages(shared_bus);
+
+    Disassembler disassembler(shared_bus);
+    for(uint16_t vector_addr : { IV_Addr::RESET, IV_Addr::NMI, IV_Addr::IRQ })
+        disassembler.trace(disassembler.read_vector(vector_addr));
+
+    std::ofstream output(argv[2]);
+    emit(output, argv[1], disassembler.blocks);
+
+    size_t instr_num = 0;
+    for(const auto& entry : disassembler.blocks)
+        instr_num += entry.second.instrs.size();
+    std::cout << disassembler.blocks.size() << " blocks, "
+              << instr_num << " instructions\n";
+
+    return output ? 0 : 1;
+}
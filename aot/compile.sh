@@ -0,0 +1 @@
+g++ -I ../core -I ../ines aot.cpp ../ines/ines.cpp -std=c++17 -Wno-overflow -o nos-aot -O2
@@ -1,8 +1,12 @@
 #ifndef  APU_H_NOS
 #define  APU_H_NOS
 
+#include <algorithm>    // min
+#include <cmath>        // llround
 #include <cstdint>
 
+#include "shared_bus.h"
+#include "blip_buffer.h"
 #include "pulse.h"
 #include "triangle.h"
 #include "noise.h"
@@ -10,6 +14,47 @@
 namespace NES
 {
 
+// The mixer's nonlinear output for each combination of channel volumes (see
+// https://wiki.nesdev.com/w/index.php/APU_Mixer), computed at compile time
+// and shared by every APU. tnd_out is indexed by the DMC's level first, so
+// that the entries for any one DMC level (in practice, while the DMC isn't
+// emulated, only those for 0) take up 1KB of consecutive cache lines
+struct Mixer_Table
+{
+    alignas(64) float pulse_out[0x20];              // [pulse_fst + pulse_snd]
+    alignas(64) float tnd_out[0x80][0x10][0x10];    // [dmc][triangle][noise]
+
+    constexpr Mixer_Table() : pulse_out(), tnd_out()
+    {
+        for(unsigned int pulse_sum = 0; pulse_sum < 0x20; ++pulse_sum)
+        {
+            double val = ((pulse_sum > 0) 
+                ? (95.88 / (100 + (8128.0 / pulse_sum)))
+                : 0);
+            pulse_out[pulse_sum] = val;
+        }
+
+        for(unsigned int dmc = 0; dmc < 0x80; ++dmc)
+        {
+            for(unsigned int triangle = 0; triangle < 0x10; ++triangle)
+            {
+                for(unsigned int noise = 0; noise < 0x10; ++noise)
+                {
+                    unsigned int sum = triangle + noise + dmc;
+                    double val = ((sum > 0)
+                        ? (159.79 / (100 + (1 / ((triangle / 8227.0) +
+                                                 (noise   / 12241.0) +
+                                                 (dmc     / 22638.0)))))
+                        : 0);
+                    tnd_out[dmc][triangle][noise] = val;
+                }
+            }
+        }
+    }
+};
+
+constexpr Mixer_Table mixer_table;
+
 class APU
 {
   private:
@@ -20,12 +65,104 @@ class APU
     Triangle triangle;
     Noise noise;
 
-    bool frame_surpress_irq;
-    bool frame_seq_alt_mode;
-    uint32_t frame_div_ctr;
-    uint8_t frame_seq;
-    float lookup_pulse_out[0x1F];
-    float lookup_tnd_out[0x10][0x10][0x80];
+    bool frame_surpress_irq = false;
+    bool frame_seq_alt_mode = false;
+    uint32_t frame_div_ctr = 0;
+    uint8_t frame_seq = 0;
+
+    // The output is synthesized from its changes, at the clock since the
+    // last delivery (counted here) at which each takes place
+    Blip_Buffer blip;
+    uint32_t frame_cycle = 0;
+    uint64_t frame_count = 0;
+    unsigned int sample_rate = default_sample_rate;
+
+    // The sample rate is scaled by rate_ratio, changes to which take effect
+    // at the next delivery
+    double rate_ratio = 1;
+    bool is_rate_ratio_changed = false;
+    uint16_t levels = 0;        // Channel volumes, 4 bits each
+    float output = 0;
+
+    // CPU cycle phases executed (see catch_up()); the channels are clocked in
+    // phase two, on every cycle (triangle) or every odd cycle (others)
+    uint64_t phase_count = 0;
+
+    // Whether vol() of some channel may have changed other than by its timer
+    // (i.e. by a register write or frame sequencer step) since the last tick
+    bool is_output_dirty = true;
+
+    // Samples are handed over at the end of each frame, and when streaming,
+    // also once delivery_ctr (counted in master cycles, as frame_div_ctr)
+    // reaches delivery_period (0 when not streaming)
+    Audio_Delivery delivery = Audio_Delivery::FRAME;
+    unsigned int delivery_sample_num = 0;
+    uint32_t delivery_period = 0;
+    uint32_t delivery_ctr = 0;
+
+    enum : unsigned int
+    {
+        frame_div_period = 89490,
+        master_cycles_per_cpu_phase = 6,
+        master_cycles_per_ppu_dot = 4
+    };
+
+    void update_delivery_period()
+    {
+        switch(delivery)
+        {
+            case(Audio_Delivery::FRAME):
+                delivery_period = 0;
+                break;
+            case(Audio_Delivery::SCANLINE):
+                delivery_period = scanln_width * master_cycles_per_ppu_dot;
+                break;
+            case(Audio_Delivery::SAMPLES):
+                delivery_period = std::llround(delivery_sample_num * 
+                                               clock_speed_hz / sample_rate);
+                break;
+        }
+    }
+
+    // Hands the samples synthesized so far over, to the frame's block or the
+    // ring
+    void deliver()
+    {
+        blip.end_frame(frame_cycle);
+        frame_cycle = 0;
+
+        if(is_rate_ratio_changed)
+        {
+            blip.change_rates(cpu_clock_speed_hz, sample_rate * rate_ratio);
+            is_rate_ratio_changed = false;
+        }
+
+        size_t num = blip.samples_avail();
+        if(delivery == Audio_Delivery::FRAME)
+        {
+            blip.read_samples(shared_bus.audiobuf.append(num), num);
+            return;
+        }
+
+        float chunk[0x100];
+        while(num > 0)
+        {
+            size_t chunk_num = std::min<size_t>(num, 0x100);
+            blip.read_samples(chunk, chunk_num);
+            shared_bus.audio_ring.push(chunk, chunk_num);
+            num -= chunk_num;
+        }
+    }
+
+    // Publishes the samples of the frame just ended (if delivering per frame)
+    void end_frame()
+    {
+        frame_count = shared_bus.get_frame_count();
+
+        deliver();
+        if(delivery == Audio_Delivery::FRAME)
+            shared_bus.audiobuf.publish();
+    }
 
     void tick_frame_quarter()
     {
@@ -43,41 +180,8 @@ class APU
             noise.tick_frame_half();
     }
 
-  public:
-    APU(Shared_Bus& shared_bus) 
-        : shared_bus(shared_bus), pulse_fst(true), pulse_snd(false)
-    {
-        // Populate mixer lookup tables
-        for(unsigned int pulse_sum = 1; pulse_sum < 0x1F; ++pulse_sum)
-        {
-            double val = ((pulse_sum > 0) 
-                ? (95.88 / (100 + (8128.0 / pulse_sum)))
-                : 0);
-            lookup_pulse_out[pulse_sum] = val;
-        }
-
-        for(unsigned int triangle = 0; triangle < 0x10; ++triangle)
-        {
-            for(unsigned int noise = 0; noise < 0x10; ++noise)
-            {
-                for(unsigned int dmc = 0; dmc < 0x80; ++dmc)
-                {
-                    unsigned int sum = triangle + noise + dmc;
-                    double val = ((sum > 0)
-                        ? (159.79 / (100 + (1 / ((triangle / 8227.0) +
-                                                 (noise   / 12241.0) +
-                                                 (dmc     / 22638.0)))))
-                        : 0);
-                    lookup_tnd_out[triangle][noise][dmc] = val;
-                }
-            }
-        }
-    }
-
     void process_frame_cpu_phase()
     {
-        constexpr unsigned int frame_div_period = 89490;
-        constexpr unsigned int master_cycles_per_cpu_phase = 6;
         frame_div_ctr += master_cycles_per_cpu_phase;
 
         if(frame_div_ctr >= frame_div_period)
@@ -112,17 +216,191 @@ class APU
 
         triangle.tick();
 
-        uint8_t pulse_vol = pulse_fst.vol() + pulse_snd.vol();
-        float pulse_out = lookup_pulse_out[pulse_vol];
-        // TODO dmc
-        float tnd_out   = lookup_tnd_out[triangle.vol()][noise.vol()][0]; 
-        float output = pulse_out + tnd_out;
-        shared_bus.audiobuf.push(output);
+        uint16_t new_levels = ((pulse_fst.vol() <<  0) |
+                               (pulse_snd.vol() <<  4) |
+                               ( triangle.vol() <<  8) |
+                               (    noise.vol() << 12));
+        if(new_levels != levels)
+        {
+            levels = new_levels;
+
+            uint8_t pulse_vol = pulse_fst.vol() + pulse_snd.vol();
+            float pulse_out = mixer_table.pulse_out[pulse_vol];
+            // TODO dmc
+            float tnd_out = mixer_table.tnd_out[0][triangle.vol()][noise.vol()];
+            float new_output = pulse_out + tnd_out;
+            blip.add_delta(frame_cycle, new_output - output);
+            output = new_output;
+        }
+
+        ++frame_cycle;
+        is_output_dirty = false;
+    }
+
+    // Equivalent to calling tick() for each of the given number of cycles
+    // from that of the next phase two on, provided that no frame sequencer
+    // step takes place meanwhile: the cycles until some channel's output may
+    // change are skipped in bulk, only ticking on those at which it may
+    void run_ticks(uint32_t cycles)
+    {
+        bool is_odd_cycle = ((phase_count / 2) % 2 == 0);
+
+        while(cycles > 0)
+        {
+            // Cycles up to (and including) the next change; the pulse and
+            // noise channels are only ticked on odd cycles
+            uint32_t until = (is_output_dirty ? 1 : cycles);
+            if(!is_output_dirty)
+            {
+                auto limit = [&until](uint32_t num)
+                {
+                    if((num > 0) && (num < until)) until = num;
+                };
+                auto odd_cycles_to = [is_odd_cycle](uint32_t ticks) -> uint32_t
+                {
+                    return ((ticks > 0) ? (2 * ticks) - (is_odd_cycle ? 1 : 0)
+                                        : 0);
+                };
+                limit(triangle.ticks_until_change());
+                limit(odd_cycles_to(pulse_fst.ticks_until_change()));
+                limit(odd_cycles_to(pulse_snd.ticks_until_change()));
+                limit(odd_cycles_to(    noise.ticks_until_change()));
+            }
+
+            uint32_t skipped = until - 1;
+            uint32_t odd_skipped = (skipped + (is_odd_cycle ? 1 : 0)) / 2;
+            pulse_fst.advance(odd_skipped);
+            pulse_snd.advance(odd_skipped);
+                noise.advance(odd_skipped);
+             triangle.advance(skipped);
+            frame_cycle += skipped;
+            if(skipped % 2) is_odd_cycle = !is_odd_cycle;
+
+            tick(is_odd_cycle);
+            is_odd_cycle = !is_odd_cycle;
+            cycles -= until;
+        }
+    }
+
+  public:
+    APU(Shared_Bus& shared_bus) 
+        : shared_bus(shared_bus), pulse_fst(true), pulse_snd(false),
+          blip(max_samples_per_frame)
+    {
+        set_sample_rate(default_sample_rate);
+    }
+
+    // Number of CPU cycle phases up to (and including) the one at which the
+    // frame sequencer next steps (and possibly asserts its IRQ)
+    uint32_t phases_until_frame_step()
+    {
+        if(frame_div_ctr >= frame_div_period) return 1;
+        uint32_t remaining = frame_div_period - frame_div_ctr;
+        return ((remaining + master_cycles_per_cpu_phase - 1) / 
+                master_cycles_per_cpu_phase);
+    }
+
+    // Likewise for the next delivery of samples into the ring
+    // Precondition: delivery_period > 0
+    uint32_t phases_until_delivery()
+    {
+        if(delivery_ctr >= delivery_period) return 1;
+        uint32_t remaining = delivery_period - delivery_ctr;
+        return ((remaining + master_cycles_per_cpu_phase - 1) / 
+                master_cycles_per_cpu_phase);
+    }
+
+    // Number of CPU cycle phases up to the next point at which the APU needs
+    // to be caught up (see catch_up())
+    uint32_t phases_until_event()
+    {
+        uint32_t phases = phases_until_frame_step();
+        if(delivery_period > 0)
+            phases = std::min(phases, phases_until_delivery());
+        return phases;
+    }
+
+    // Executes the given number of CPU cycle phases, in each of which the
+    // frame sequencer is clocked, and in phase two of each cycle also the
+    // channels (i.e. phase one and phase two of every cycle, starting with
+    // phase one of the first). The APU is run lazily ('catch-up', as the PPU
+    // is): the CPU accumulates phases, and only executes them before an
+    // access to the APU's registers, at a frame sequencer step (which may
+    // assert the IRQ line), at a delivery of streamed samples or once a frame
+    // has ended (publishing its audio)
+    void catch_up(uint32_t phases)
+    {
+        while(phases > 0)
+        {
+            // Phases before the next sequencer step (up to the next delivery),
+            // or else the step's own
+            uint32_t num = std::min(phases, phases_until_frame_step() - 1);
+            if(delivery_period > 0)
+                num = std::min(num, phases_until_delivery());
+
+            if(num > 0)
+            {
+                bool is_phase_two = (phase_count % 2);
+                frame_div_ctr += num * master_cycles_per_cpu_phase;
+                delivery_ctr  += num * master_cycles_per_cpu_phase;
+                run_ticks((num + (is_phase_two ? 1 : 0)) / 2);
+                phase_count += num;
+                phases -= num;
+            }
+            else
+            {
+                process_frame_cpu_phase();
+                delivery_ctr += master_cycles_per_cpu_phase;
+                is_output_dirty = true;
+                if(phase_count % 2) run_ticks(1);
+                ++phase_count;
+                --phases;
+            }
+
+            if((delivery_period > 0) && (delivery_ctr >= delivery_period))
+            {
+                delivery_ctr -= delivery_period;
+                deliver();
+            }
+        }
+
+        if(shared_bus.get_frame_count() != frame_count)
+            end_frame();
+    }
+
+    // Frame whose audio is being synthesized
+    uint64_t get_frame_count() { return frame_count; }
+
+    // Discards the samples synthesized but not delivered so far
+    // Precondition: new_sample_rate <= max_sample_rate
+    void set_sample_rate(unsigned int new_sample_rate)
+    {
+        sample_rate = new_sample_rate;
+        blip.set_rates(cpu_clock_speed_hz, sample_rate * rate_ratio);
+        is_rate_ratio_changed = false;
+        update_delivery_period();
+    }
+
+    // Precondition: 0.99 <= ratio <= 1.01
+    void set_rate_ratio(double ratio)
+    {
+        rate_ratio = ratio;
+        is_rate_ratio_changed = true;
+    }
+
+    // Precondition: new_delivery isn't SAMPLES, or sample_num > 0
+    void set_delivery(Audio_Delivery new_delivery, unsigned int sample_num)
+    {
+        delivery = new_delivery;
+        delivery_sample_num = sample_num;
+        delivery_ctr = 0;
+        update_delivery_period();
     }
 
     // Precondition: sub_addr < 4
     void write_reg_pulse(uint8_t sub_addr, uint8_t data, bool pulse_fst_snd)
     {
+        is_output_dirty = true;
         Pulse& pulse = (pulse_fst_snd ? pulse_fst : pulse_snd);
         switch(sub_addr)
         {
@@ -137,6 +415,7 @@ class APU
     // Precondition: sub_addr < 4
     void write_reg_triangle(uint8_t sub_addr, uint8_t data)
     {
+        is_output_dirty = true;
         switch(sub_addr)
         {
             case(0): triangle.write_a(data); break;
@@ -149,6 +428,7 @@ class APU
 
     void write_reg_noise(uint8_t sub_addr, uint8_t data)
     {
+        is_output_dirty = true;
         switch(sub_addr)
         {
             case(0): noise.write_a(data); break;
@@ -178,6 +458,7 @@ class APU
 
     void write_reg_status(uint8_t data)
     {
+        is_output_dirty = true;
         pulse_fst.set_enabled(data & (1U << 0));
         pulse_snd.set_enabled(data & (1U << 1));
          triangle.set_enabled(data & (1U << 2));
@@ -188,6 +469,7 @@ class APU
 
     void write_reg_frame(uint8_t data)
     {
+        is_output_dirty = true;
         frame_surpress_irq = (data & (1U << 6));
         frame_seq_alt_mode = (data & (1U << 7));
         if(frame_surpress_irq) 
@@ -0,0 +1,151 @@
+#ifndef  BLIP_BUFFER_H_NOS
+#define  BLIP_BUFFER_H_NOS
+
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstddef>      // size_t
+#include <cmath>        // sin, cos, exp, llround
+#include <cstring>      // memmove, memset
+#include <vector>
+
+namespace NES
+{
+
+
+// Band-limited step synthesis (see http://www.slack.net/~ant/bl-synth/):
+// instead of being sampled once per clock, a signal is described by the
+// changes in its amplitude, each of which adds a windowed-sinc step to the
+// output at its exact position between output samples. Output samples are
+// then produced at the host rate directly, without aliasing, and work is
+// only done where the signal changes. Positions are in clocks since the start
+// of the current frame; the output is also high-pass filtered at 90Hz, as by
+// the NES's own output circuitry (see
+// https://wiki.nesdev.com/w/index.php/APU_Mixer)
+class Blip_Buffer
+{
+  public:
+    enum : unsigned int
+    {
+        kernel_width = 16,      // Output samples each step is spread over
+        phase_bits = 5,
+        phase_num = 1U << phase_bits
+    };
+
+  private:
+    // Impulse responses (stored rather than steps, the output being their
+    // running sum) at each fractional position between output samples
+    struct Kernel
+    {
+        float taps[phase_num][kernel_width];
+
+        Kernel()
+        {
+            constexpr double pi = 3.14159265358979323846;
+            constexpr double cutoff = 0.45;     // Of the output sample rate
+            constexpr double half = kernel_width / 2;
+
+            for(unsigned int phase = 0; phase < phase_num; ++phase)
+            {
+                double sum = 0;
+                double taps_d[kernel_width];
+                for(unsigned int k = 0; k < kernel_width; ++k)
+                {
+                    double t = (k + 1.0 - half) - (double(phase) / phase_num);
+                    double x = 2 * pi * cutoff * t;
+                    double sinc = ((t == 0) ? 1 : (std::sin(x) / x));
+                    double w = (t + half) / kernel_width;   // Blackman
+                    double window = 0.42 - 0.5  * std::cos(2 * pi * w)
+                                         + 0.08 * std::cos(4 * pi * w);
+                    taps_d[k] = sinc * window;
+                    sum += taps_d[k];
+                }
+
+                // Each step must add up to exactly its delta
+                for(unsigned int k = 0; k < kernel_width; ++k)
+                    taps[phase][k] = taps_d[k] / sum;
+            }
+        }
+    };
+
+    static const Kernel& get_kernel()
+    {
+        static const Kernel kernel;
+        return kernel;
+    }
+
+    std::vector<float> deltas;
+
+    // Output samples per clock, and the position of the frame's first clock
+    // in output samples, both in 32.32 fixed point
+    uint64_t factor = 0;
+    uint64_t offset = 0;
+
+    float level = 0;
+    float hp_in = 0;
+    float hp_out = 0;
+    float hp_coef = 0;
+
+  public:
+    // Precondition: each frame ends (see end_frame()) before max_samples
+    // samples are available
+    Blip_Buffer(size_t max_samples) : deltas(max_samples + kernel_width) {}
+
+    // Discards the samples not read yet
+    void set_rates(double clock_hz, double sample_rate)
+    {
+        constexpr double pi = 3.14159265358979323846;
+        change_rates(clock_hz, sample_rate);
+        hp_coef = std::exp(-2 * pi * 90 / sample_rate);
+        offset = 0;
+        std::memset(deltas.data(), 0, deltas.size() * sizeof(float));
+    }
+
+    // Changes the rates (e.g. slightly, to track another clock) from the
+    // current position on, keeping the samples not read yet
+    // Precondition: no add_delta() since the last end_frame()
+    void change_rates(double clock_hz, double sample_rate)
+    {
+        factor = std::llround((sample_rate / clock_hz) * 4294967296.0);
+    }
+
+    // Changes the amplitude by delta at the given clock of the frame
+    void add_delta(uint32_t clock, float delta)
+    {
+        uint64_t pos = offset + (clock * factor);
+        const float* taps = get_kernel().taps[(pos >> (32 - phase_bits)) %
+                                              phase_num];
+        float* dst = &deltas[pos >> 32];
+        for(unsigned int k = 0; k < kernel_width; ++k)
+            dst[k] += taps[k] * delta;
+    }
+
+    // The frame ends after the given number of clocks
+    void end_frame(uint32_t clocks) { offset += clocks * factor; }
+
+    // Output samples complete so far
+    size_t samples_avail() { return (offset >> 32); }
+
+    // Precondition: num <= samples_avail()
+    void read_samples(float* dst, size_t num)
+    {
+        for(size_t i = 0; i < num; ++i)
+        {
+            level += deltas[i];
+            hp_out = (level - hp_in) + (hp_coef * hp_out);
+            hp_in = level;
+            dst[i] = hp_out;
+        }
+
+        // Keep whatever extends past the samples read (steps only extend up
+        // to kernel_width samples past those complete), so that reading a
+        // few samples at a time stays cheap
+        size_t rest = samples_avail() + kernel_width - num;
+        std::memmove(deltas.data(), deltas.data() + num, rest * sizeof(float));
+        std::memset(deltas.data() + rest, 0, num * sizeof(float));
+        offset -= (uint64_t(num) << 32);
+    }
+};
+
+
+}
+
+#endif //BLIP_BUFFER_H_NOS
@@ -2,6 +2,9 @@
 #define  CART_H_NOS
 
 #include "shared_bus.h"
+#include "chr_cache.h"
+
+#include <memory>       // unique_ptr
 
 namespace NES
 {
@@ -15,6 +18,20 @@ class Cartridge
 
     virtual uint8_t cpu_read (Shared_Bus&, uint16_t addr) = 0;
     virtual void    cpu_write(Shared_Bus&, uint16_t addr, uint8_t data) = 0;
+
+    // Fill in the Shared_Bus CPU page map entries for cartridge space
+    // ($4020-$FFFF) which can be accessed directly; to be invoked again by the
+    // mapper itself whenever its bank mapping changes
+    virtual void    cpu_map_pages(Shared_Bus&) = 0;
+
+    // Fill in the Shared_Bus PPU page map entries ($0000-$3EFF) likewise
+    virtual void    ppu_map_pages(Shared_Bus&) = 0;
+
+    // An independent cartridge in the same state (e.g. to replay accesses
+    // into on another thread); memory shared between the two is never written
+    virtual std::unique_ptr<Cartridge> clone() const = 0;
+
+    virtual ~Cartridge() = default;
 };
 
 
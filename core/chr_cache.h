@@ -0,0 +1,114 @@
+#ifndef  CHR_CACHE_H_NOS
+#define  CHR_CACHE_H_NOS
+
+#include <cstdint>      // uint8_t, uint64_t
+#include <cstddef>      // size_t
+#include <cstring>      // memcpy
+#include <vector>
+
+namespace NES
+{
+
+
+// One row (8 pixels) of a pattern table tile, as 2-bit pixel values (0-3) one
+// per byte, leftmost pixel first in memory; in both the normal and the
+// horizontally flipped order. Byte-wise arithmetic on the packed values then
+// handles 8 pixels at once regardless of host endianness
+struct Chr_Row
+{
+    uint64_t px;
+    uint64_t px_flipped;
+
+    bool operator==(const Chr_Row& other) const
+    {
+        return ((px == other.px) && (px_flipped == other.px_flipped));
+    }
+};
+
+// lo and hi are the row's bytes in the low and high bit planes of the tile
+inline Chr_Row decode_chr_row(uint8_t lo, uint8_t hi)
+{
+    uint8_t px[8], px_flipped[8];
+    for(unsigned int j = 0; j < 8; ++j)
+    {
+        unsigned int bit = 7 - j;
+        px[j] = (((lo >> bit) & 1U) << 0) |
+                (((hi >> bit) & 1U) << 1);
+        px_flipped[7 - j] = px[j];
+    }
+
+    Chr_Row row;
+    memcpy(&row.px, px, sizeof(px));
+    memcpy(&row.px_flipped, px_flipped, sizeof(px_flipped));
+    return row;
+}
+
+// Inverse of decode_chr_row(); plane is 0 (low) or 1 (high)
+inline uint8_t encode_chr_plane(const Chr_Row& row, unsigned int plane)
+{
+    uint8_t px[8];
+    memcpy(px, &row.px, sizeof(px));
+
+    uint8_t byte = 0;
+    for(unsigned int j = 0; j < 8; ++j)
+        byte |= ((px[j] >> plane) & 1U) << (7 - j);
+    return byte;
+}
+
+// Every row of a cartridge's CHR memory (ROM or RAM) in decoded form, indexed
+// by offset into that memory (i.e. by physical rather than PPU address, so it
+// stays valid across bank switches); as CHR-ROM never changes, cartridges
+// loaded from the same ROM can share one (see load_ines()). Whoever writes CHR
+// memory must update() the cache accordingly
+class Chr_Cache
+{
+  private:
+    std::vector<Chr_Row> rows;
+
+  public:
+    // Tiles are 16 bytes: 8 rows of the low plane, then 8 of the high plane;
+    // the rows of consecutive tiles are consecutive too
+    static size_t get_row_index(size_t offset)
+    {
+        return (((offset >> 4) << 3) | (offset % 8));
+    }
+
+    // Precondition: size is a multiple of 16
+    Chr_Cache(const uint8_t* chr, size_t size) : rows(size / 2)
+    {
+        for(size_t offset = 0; offset < size; offset += 0x10)
+            for(size_t i = 0; i < 8; ++i)
+                update(chr, offset + i);
+    }
+
+    // offset is that of the row's byte in the low plane
+    const Chr_Row& get_row(size_t offset) const
+    {
+        return rows[get_row_index(offset)];
+    }
+
+    // The rows from that at offset onwards
+    // Precondition: offset is a multiple of 16
+    const Chr_Row* get_rows(size_t offset) const
+    {
+        return &(rows[get_row_index(offset)]);
+    }
+
+    // Re-decodes the row containing the byte at offset (in either plane)
+    void update(const uint8_t* chr, size_t offset)
+    {
+        size_t lo_offset = offset & ~size_t(8);
+        rows[get_row_index(offset)] = decode_chr_row(chr[lo_offset],
+                                                     chr[lo_offset + 8]);
+    }
+
+    bool operator==(const Chr_Cache& other) const
+    {
+        return (rows == other.rows);
+    }
+};
+
+
+}
+
+#endif //CHR_CACHE_H_NOS
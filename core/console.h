@@ -6,6 +6,7 @@
 #include "cpu.h"
 #include "ppu.h"
 #include "apu.h"
+#include "deferred_ppu.h"
 //include mapper
 
 #include <cstdint>      // uint8_t, uint32_t
@@ -16,50 +17,181 @@ namespace NES
 {
 
 
-static constexpr double clock_speed_hz = (1000 * 1000) * (236.25 / 11);
-static constexpr double cpu_clock_speed_hz = clock_speed_hz / 12;
-
-class Console
+// Cartridge-independent part of a console, through which a Basic_Console of
+// any cartridge type can be driven
+class Console_Base
 {
   public:
     Shared_Bus shared_bus;
-    std::unique_ptr<Cartridge> cart;
     std::unique_ptr<Controller> port_one = std::make_unique<Controller>();
     std::unique_ptr<Controller> port_two = std::make_unique<Controller>();
-    PPU ppu;
-    APU apu;
-    CPU cpu;
+
+  protected:
+    // Where frames are published (see enable_deferred_rendering())
+    Shared_Bus* frame_bus = &shared_bus;
 
   public:
-    const uint8_t (&get_framebuf())[pixel_quantity]
+    // The latest completed frame; may be called from a thread other than the
+    // one running exec(), and the buffer returned stays valid until the next
+    // call
+    const uint16_t (&get_framebuf())[pixel_quantity]
+    {
+        frame_bus->framebuf.acquire();
+        return frame_bus->framebuf.front();
+    }
+
+    // Has frames produced directly into the given caller-owned buffers of
+    // pixel_quantity pixel values each (e.g. in shared memory), rather than
+    // into the console's own; get_framebuf() then returns one of them, which
+    // the caller may also read in place once it has been returned
+    // Precondition: exec() hasn't been called yet (but, if used,
+    // enable_deferred_rendering() has)
+    void set_frame_destinations(uint16_t* fst, uint16_t* snd, uint16_t* trd)
     {
-        return shared_bus.framebuf.front();
+        frame_bus->framebuf.set_destinations(fst, snd, trd);
     }
 
+    // The audio of the latest frame completed by exec(), as above. Frames
+    // and audio are handed over separately, so that the two latest need not
+    // be of the same frame (e.g. with deferred rendering, or if exec()
+    // completes a frame between both calls)
     const float (&get_audiobuf())[max_samples_per_frame]
     {
+        shared_bus.audiobuf.acquire();
         return shared_bus.audiobuf.front();
     }
 
+    // Number of samples in the buffer last returned by get_audiobuf()
+    size_t get_audio_sample_num() { return shared_bus.audiobuf.front_size(); }
+
+    // Where samples are streamed while not delivered per frame; may be
+    // drained from another thread (e.g. by an audio callback)
+    Shared_Bus::Sample_Ring& get_audio_ring() { return shared_bus.audio_ring; }
+
     uint64_t get_frame_count() { return shared_bus.get_frame_count(); }
 
+    // Skips pixel generation (leaving the last full frame as the latest) for
+    // skip_num out of every period frames, or for the next frame to start;
+    // everything the game can observe, such as sprite 0 hits, sprite overflow
+    // and cartridge accesses, still takes place
+    // Precondition: period > 0
+    void set_frame_skip(unsigned int skip_num, unsigned int period)
+    {
+        shared_bus.frame_skip_num = skip_num;
+        shared_bus.frame_skip_period = period;
+    }
+
+    void skip_next_frame() { shared_bus.is_frame_skip_requested = true; }
+
     void set_port_one(Controller::Button btn, bool is_pressed)
     { port_one->set_state(btn, is_pressed); }
 
     void set_port_two(Controller::Button btn, bool is_pressed)
     { port_two->set_state(btn, is_pressed); }
 
-    void exec() { cpu.execute_instruction(); }
+    // Generates pixels on a worker thread (see Deferred_Renderer), which may
+    // lag behind exec() by a few frames; get_framebuf() then returns the
+    // latest frame the worker has completed
+    // Precondition: exec() hasn't been called yet
+    virtual void enable_deferred_rendering() = 0;
+
+    // Blocks until the frames completed by exec() so far have been rendered
+    virtual void wait_for_rendering() = 0;
+
+    // Precondition: sample_rate <= max_sample_rate
+    virtual void set_sample_rate(unsigned int sample_rate) = 0;
+
+    // Streams audio into get_audio_ring() as it is synthesized, every
+    // scanline's duration or every sample_num samples, rather than publishing
+    // it per frame through get_audiobuf() (see Audio_Delivery); a consumer
+    // pulling from the ring then only lags by a few milliseconds
+    // Precondition: delivery isn't SAMPLES, or sample_num > 0
+    virtual void set_audio_delivery(Audio_Delivery delivery,
+                                    unsigned int sample_num = 0) = 0;
+
+    // Scales the sample rate by ratio from the next delivery on, without
+    // discarding anything, so that the samples produced per emulated second
+    // can track the clock of whatever consumes them (see Rate_Control)
+    // Precondition: 0.99 <= ratio <= 1.01
+    virtual void set_audio_rate_ratio(double ratio) = 0;
+
+    virtual void exec() = 0;
+    virtual uint64_t get_instruction_count() = 0;
+    virtual uint64_t get_scanln_count() = 0;
+    virtual uint64_t get_fast_scanln_count() = 0;
+
+    virtual ~Console_Base() = default;
+};
+
+// The CPU and PPU access the cartridge as a Cart; with Cart = Cartridge,
+// through virtual calls, or, with a concrete (final) mapper class, through
+// direct calls which can be inlined (see load_ines_console())
+template<class Cart>
+class Basic_Console final : public Console_Base
+{
+  public:
+    std::unique_ptr<Cart> cart;
+    Basic_PPU<Cart> ppu;
+    APU apu;
+    Basic_CPU<Cart> cpu;
+    std::unique_ptr<Deferred_Renderer<Cart>> renderer;
+
+  public:
+    void exec() override
+    {
+        cpu.execute_instruction();
+        if(renderer) renderer->poll();
+    }
+
+    void enable_deferred_rendering() override
+    {
+        renderer = std::make_unique<Deferred_Renderer<Cart>>(shared_bus, 
+                                                             *cart);
+        frame_bus = &(renderer->get_bus());
+    }
+
+    void set_sample_rate(unsigned int sample_rate) override
+    {
+        apu.set_sample_rate(sample_rate);
+    }
+
+    void set_audio_delivery(Audio_Delivery delivery, 
+                            unsigned int sample_num) override
+    {
+        apu.set_delivery(delivery, sample_num);
+    }
+
+    void set_audio_rate_ratio(double ratio) override
+    {
+        apu.set_rate_ratio(ratio);
+    }
+
+    void wait_for_rendering() override
+    {
+        if(renderer) renderer->wait();
+    }
+
+    uint64_t get_instruction_count() override
+    { 
+        return cpu.get_instruction_count(); 
+    }
+
+    uint64_t get_scanln_count() override { return ppu.get_scanln_count(); }
+
+    uint64_t get_fast_scanln_count() override
+    {
+        return ppu.get_fast_scanln_count();
+    }
 
-    Console(std::unique_ptr<Cartridge> inserted_cart) 
-        : shared_bus(),
-          cart(std::move(inserted_cart)),
+    Basic_Console(std::unique_ptr<Cart> inserted_cart) 
+        : cart(std::move(inserted_cart)),
           ppu(shared_bus, *(cart.get())),
           apu(shared_bus),
           cpu(shared_bus, *(cart.get()), ppu, apu, 
               *(port_one.get()), *(port_two.get())) {}
 };
 
+using Console = Basic_Console<Cartridge>;
 
 }
 #endif // CONSOLE_H_NOS
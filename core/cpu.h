@@ -5,9 +5,18 @@
 #include "cart.h"
 #include "ppu.h"
 #include "apu.h"
+#include "decode_cache.h"
+#ifdef NOS_CPU_JIT
+#include "jit.h"
+#endif
+
+// Either compiled code backend (dynamic/static recompilation)
+#if defined(NOS_CPU_JIT) || defined(NOS_CPU_AOT)
+#define NOS_CPU_COMPILED_CODE
+#endif
 
 #include <cstdint>  // uint8_t, uint16_t
-#include <cstring>  // memcpy
+#include <cstring>  // memcpy, memcmp
 #include <utility>  // pair
 #include <vector>
 
@@ -75,14 +84,132 @@ namespace IV_Addr
 }
 
 
-// Ricoh 2A03
-class CPU
+// Opcode map as (opcode, instruction, addressing mode) entries, shared by the
+// dispatch implementations in CPU::execute_instruction()
+#define NOS_OPCODE_MAP(X) \
+/*0x00*/ X(0x00,BRK,Imp)  X(0x01,ORA,InX)  X(0x02,STP,Imp)  X(0x03,SLO,InX)  \
+/*0x04*/ X(0x04,NOP,ZP)   X(0x05,ORA,ZP)   X(0x06,ASL,ZP)   X(0x07,SLO,ZP)   \
+/*0x08*/ X(0x08,PHP,Imp)  X(0x09,ORA,Imm)  X(0x0A,ASL,Acc)  X(0x0B,ANC,Imm)  \
+/*0x0C*/ X(0x0C,NOP,Ab)   X(0x0D,ORA,Ab)   X(0x0E,ASL,Ab)   X(0x0F,SLO,Ab)   \
+/*0x10*/ X(0x10,BPL,Imm)  X(0x11,ORA,InY)  X(0x12,STP,Imp)  X(0x13,SLO,InYS) \
+/*0x14*/ X(0x14,NOP,ZPX)  X(0x15,ORA,ZPX)  X(0x16,ASL,ZPX)  X(0x17,SLO,ZPX)  \
+/*0x18*/ X(0x18,CLC,Imp)  X(0x19,ORA,AbY)  X(0x1A,NOP,Imp)  X(0x1B,SLO,AbYS) \
+/*0x1C*/ X(0x1C,NOP,AbX)  X(0x1D,ORA,AbX)  X(0x1E,ASL,AbXS) X(0x1F,SLO,AbXS) \
+/*0x20*/ X(0x20,JSR,Ab)   X(0x21,AND,InX)  X(0x22,STP,Imp)  X(0x23,RLA,InX)  \
+/*0x24*/ X(0x24,BIT,ZP)   X(0x25,AND,ZP)   X(0x26,ROL,ZP)   X(0x27,RLA,ZP)   \
+/*0x28*/ X(0x28,PLP,Imp)  X(0x29,AND,Imm)  X(0x2A,ROL,Acc)  X(0x2B,ANC,Imm)  \
+/*0x2C*/ X(0x2C,BIT,Ab)   X(0x2D,AND,Ab)   X(0x2E,ROL,Ab)   X(0x2F,RLA,Ab)   \
+/*0x30*/ X(0x30,BMI,Imm)  X(0x31,AND,InY)  X(0x32,STP,Imp)  X(0x33,RLA,InYS) \
+/*0x34*/ X(0x34,NOP,ZPX)  X(0x35,AND,ZPX)  X(0x36,ROL,ZPX)  X(0x37,RLA,ZPX)  \
+/*0x38*/ X(0x38,SEC,Imp)  X(0x39,AND,AbY)  X(0x3A,NOP,Imp)  X(0x3B,RLA,AbYS) \
+/*0x3C*/ X(0x3C,NOP,AbX)  X(0x3D,AND,AbX)  X(0x3E,ROL,AbXS) X(0x3F,RLA,AbXS) \
+/*0x40*/ X(0x40,RTI,Imp)  X(0x41,EOR,InX)  X(0x42,STP,Imp)  X(0x43,SRE,InX)  \
+/*0x44*/ X(0x44,NOP,ZP)   X(0x45,EOR,ZP)   X(0x46,LSR,ZP)   X(0x47,SRE,ZP)   \
+/*0x48*/ X(0x48,PHA,Imp)  X(0x49,EOR,Imm)  X(0x4A,LSR,Acc)  X(0x4B,ALR,Imm)  \
+/*0x4C*/ X(0x4C,JMP,Ab)   X(0x4D,EOR,Ab)   X(0x4E,LSR,Ab)   X(0x4F,SRE,Ab)   \
+/*0x50*/ X(0x50,BVC,Imm)  X(0x51,EOR,InY)  X(0x52,STP,Imp)  X(0x53,SRE,InYS) \
+/*0x54*/ X(0x54,NOP,ZPX)  X(0x55,EOR,ZPX)  X(0x56,LSR,ZPX)  X(0x57,SRE,ZPX)  \
+/*0x58*/ X(0x58,CLI,Imp)  X(0x59,EOR,AbY)  X(0x5A,NOP,Imp)  X(0x5B,SRE,AbYS) \
+/*0x5C*/ X(0x5C,NOP,AbX)  X(0x5D,EOR,AbX)  X(0x5E,LSR,AbXS) X(0x5F,SRE,AbXS) \
+/*0x60*/ X(0x60,RTS,Imp)  X(0x61,ADC,InX)  X(0x62,STP,Imp)  X(0x63,RRA,InX)  \
+/*0x64*/ X(0x64,NOP,ZP)   X(0x65,ADC,ZP)   X(0x66,ROR,ZP)   X(0x67,RRA,ZP)   \
+/*0x68*/ X(0x68,PLA,Imp)  X(0x69,ADC,Imm)  X(0x6A,ROR,Acc)  X(0x6B,ARR,Imm)  \
+/*0x6C*/ X(0x6C,JMP,In)   X(0x6D,ADC,Ab)   X(0x6E,ROR,Ab)   X(0x6F,RRA,Ab)   \
+/*0x70*/ X(0x70,BVS,Imm)  X(0x71,ADC,InY)  X(0x72,STP,Imp)  X(0x73,RRA,InYS) \
+/*0x74*/ X(0x74,NOP,ZPX)  X(0x75,ADC,ZPX)  X(0x76,ROR,ZPX)  X(0x77,RRA,ZPX)  \
+/*0x78*/ X(0x78,SEI,Imp)  X(0x79,ADC,AbY)  X(0x7A,NOP,Imp)  X(0x7B,RRA,AbYS) \
+/*0x7C*/ X(0x7C,NOP,AbX)  X(0x7D,ADC,AbX)  X(0x7E,ROR,AbXS) X(0x7F,RRA,AbXS) \
+/*0x80*/ X(0x80,NOP,Imm)  X(0x81,STA,InX)  X(0x82,NOP,Imm)  X(0x83,SAX,InX)  \
+/*0x84*/ X(0x84,STY,ZP)   X(0x85,STA,ZP)   X(0x86,STX,ZP)   X(0x87,SAX,ZP)   \
+/*0x88*/ X(0x88,DEY,Imp)  X(0x89,NOP,Imm)  X(0x8A,TXA,Imp)  X(0x8B,XAA,Imm)  \
+/*0x8C*/ X(0x8C,STY,Ab)   X(0x8D,STA,Ab)   X(0x8E,STX,Ab)   X(0x8F,SAX,Ab)   \
+/*0x90*/ X(0x90,BCC,Imm)  X(0x91,STA,InYS) X(0x92,STP,Imp)  X(0x93,AHX,InY)  \
+/*0x94*/ X(0x94,STY,ZPX)  X(0x95,STA,ZPX)  X(0x96,STX,ZPY)  X(0x97,SAX,ZPY)  \
+/*0x98*/ X(0x98,TYA,Imp)  X(0x99,STA,AbYS) X(0x9A,TXS,Imp)  X(0x9B,TAS,AbY)  \
+/*0x9C*/ X(0x9C,SHY,AbX)  X(0x9D,STA,AbXS) X(0x9E,SHX,AbY)  X(0x9F,AHX,AbY)  \
+/*0xA0*/ X(0xA0,LDY,Imm)  X(0xA1,LDA,InX)  X(0xA2,LDX,Imm)  X(0xA3,LAX,InX)  \
+/*0xA4*/ X(0xA4,LDY,ZP)   X(0xA5,LDA,ZP)   X(0xA6,LDX,ZP)   X(0xA7,LAX,ZP)   \
+/*0xA8*/ X(0xA8,TAY,Imp)  X(0xA9,LDA,Imm)  X(0xAA,TAX,Imp)  X(0xAB,LAX,Imm)  \
+/*0xAC*/ X(0xAC,LDY,Ab)   X(0xAD,LDA,Ab)   X(0xAE,LDX,Ab)   X(0xAF,LAX,Ab)   \
+/*0xB0*/ X(0xB0,BCS,Imm)  X(0xB1,LDA,InY)  X(0xB2,STP,Imp)  X(0xB3,LAX,InY)  \
+/*0xB4*/ X(0xB4,LDY,ZPX)  X(0xB5,LDA,ZPX)  X(0xB6,LDX,ZPY)  X(0xB7,LAX,ZPY)  \
+/*0xB8*/ X(0xB8,CLV,Imp)  X(0xB9,LDA,AbY)  X(0xBA,TSX,Imp)  X(0xBB,LAS,AbY)  \
+/*0xBC*/ X(0xBC,LDY,AbX)  X(0xBD,LDA,AbX)  X(0xBE,LDX,AbY)  X(0xBF,LAX,AbY)  \
+/*0xC0*/ X(0xC0,CPY,Imm)  X(0xC1,CMP,InX)  X(0xC2,NOP,Imm)  X(0xC3,DCP,InX)  \
+/*0xC4*/ X(0xC4,CPY,ZP)   X(0xC5,CMP,ZP)   X(0xC6,DEC,ZP)   X(0xC7,DCP,ZP)   \
+/*0xC8*/ X(0xC8,INY,Imp)  X(0xC9,CMP,Imm)  X(0xCA,DEX,Imp)  X(0xCB,AXS,Imm)  \
+/*0xCC*/ X(0xCC,CPY,Ab)   X(0xCD,CMP,Ab)   X(0xCE,DEC,Ab)   X(0xCF,DCP,Ab)   \
+/*0xD0*/ X(0xD0,BNE,Imm)  X(0xD1,CMP,InY)  X(0xD2,STP,Imp)  X(0xD3,DCP,InYS) \
+/*0xD4*/ X(0xD4,NOP,ZPX)  X(0xD5,CMP,ZPX)  X(0xD6,DEC,ZPX)  X(0xD7,DCP,ZPX)  \
+/*0xD8*/ X(0xD8,CLD,Imp)  X(0xD9,CMP,AbY)  X(0xDA,NOP,Imp)  X(0xDB,DCP,AbYS) \
+/*0xDC*/ X(0xDC,NOP,AbX)  X(0xDD,CMP,AbX)  X(0xDE,DEC,AbXS) X(0xDF,DCP,AbXS) \
+/*0xE0*/ X(0xE0,CPX,Imm)  X(0xE1,SBC,InX)  X(0xE2,NOP,Imm)  X(0xE3,ISC,InX)  \
+/*0xE4*/ X(0xE4,CPX,ZP)   X(0xE5,SBC,ZP)   X(0xE6,INC,ZP)   X(0xE7,ISC,ZP)   \
+/*0xE8*/ X(0xE8,INX,Imp)  X(0xE9,SBC,Imm)  X(0xEA,NOP,Imp)  X(0xEB,SBC,Imm)  \
+/*0xEC*/ X(0xEC,CPX,Ab)   X(0xED,SBC,Ab)   X(0xEE,INC,Ab)   X(0xEF,ISC,Ab)   \
+/*0xF0*/ X(0xF0,BEQ,Imm)  X(0xF1,SBC,InY)  X(0xF2,STP,Imp)  X(0xF3,ISC,InYS) \
+/*0xF4*/ X(0xF4,NOP,ZPX)  X(0xF5,SBC,ZPX)  X(0xF6,INC,ZPX)  X(0xF7,ISC,ZPX)  \
+/*0xF8*/ X(0xF8,SED,Imp)  X(0xF9,SBC,AbY)  X(0xFA,NOP,Imp)  X(0xFB,ISC,AbYS) \
+/*0xFC*/ X(0xFC,NOP,AbX)  X(0xFD,SBC,AbX)  X(0xFE,INC,AbXS) X(0xFF,ISC,AbXS)
+
+struct Opcode_Info
+{
+    Instr instr;
+    AddrMode addr_mode;
+};
+
+// Indexed by opcode
+static constexpr Opcode_Info opcode_info[0x100] = 
+{
+#define NOS_OPCODE_INFO(code, i, am) { i, am },
+    NOS_OPCODE_MAP(NOS_OPCODE_INFO)
+#undef NOS_OPCODE_INFO
+};
+
+// Opcode and operand bytes of an instruction, as embedded in compiled code
+struct Decoded_Instr
+{
+    uint8_t bytes[3];
+};
+
+// Number of operand bytes following the opcode
+constexpr unsigned int operand_size(AddrMode am)
+{
+    switch(am)
+    {
+        case(Imp): case(Acc):
+            return 0;
+        case(Ab):  case(AbX): case(AbXS): case(AbY): case(AbYS): case(In):
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// Instructions after which execution may not continue at the next opcode
+constexpr bool is_control_flow(Instr i)
+{
+    switch(i)
+    {
+        case(BCC): case(BCS): case(BEQ): case(BMI): case(BNE): case(BPL):
+        case(BVC): case(BVS): case(JMP): case(JSR): case(RTS): case(RTI):
+        case(BRK): case(STP):
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// Ricoh 2A03, connected to a cartridge of type Cart (see Basic_Console)
+template<class Cart>
+class Basic_CPU
 {
   private:
 
     Shared_Bus& shared_bus;
-    Cartridge& cart;
-    PPU& ppu;
+    Cart& cart;
+    Basic_PPU<Cart>& ppu;
     APU& apu;
     Controller& port_one;
     Controller& port_two;
@@ -91,10 +218,39 @@ class CPU
 
     uint8_t A;              // Accumulator
     uint8_t X, Y;           // Index (general-purpose) registers
-    uint8_t PS;             // Processor status (flags)
+    uint8_t PS;             // Processor status (flags; see below for N/Z/C/V)
     uint8_t SP;             // Stack pointer
     uint16_t PC;            // Program counter
 
+    // The N/Z/C/V flags are set by most instructions but rarely read, so
+    // rather than being assigned within PS, they are kept in a form cheaper to
+    // produce, and only materialized when PS is needed as a whole (PHP, BRK and
+    // interrupts, debugging); their bits within PS itself are meaningless
+    uint16_t flag_nz;       // Z: low byte is 0, N: bit 7 or bit 8 is set
+    bool     flag_c;        // C
+    uint8_t  flag_v;        // V: bit 7 is set
+
+    uint8_t get_PS() const
+    {
+        uint8_t flags = PS & ~(PS_Flags::NEGATIVE | PS_Flags::OVERFLOW |
+                               PS_Flags::ZERO     | PS_Flags::CARRY);
+        if(flag_nz & 0x180U)        flags |= PS_Flags::NEGATIVE;
+        if(flag_v & (1U << 7))      flags |= PS_Flags::OVERFLOW;
+        if((flag_nz % 0x100) == 0)  flags |= PS_Flags::ZERO;
+        if(flag_c)                  flags |= PS_Flags::CARRY;
+
+        return flags;
+    }
+
+    void set_PS(uint8_t flags)
+    {
+        PS = flags;
+        flag_nz = ((flags & PS_Flags::ZERO)     ? 0 : 1) |
+                  ((flags & PS_Flags::NEGATIVE) ? 0x100U : 0);
+        flag_c  = (flags & PS_Flags::CARRY);
+        flag_v  = ((flags & PS_Flags::OVERFLOW) ? (1U << 7) : 0);
+    }
+
     uint16_t effective_operand;     // Derived from actual operand (if supplied)
     bool should_branch = false;
 
@@ -108,18 +264,85 @@ class CPU
     bool should_interrupt = false;
     bool is_interrupt = false;
     bool is_oam_dma_active = false;
+    bool is_idle_loop_candidate = false;
+    uint16_t idle_loop_jump_addr;   // Address of the backward branch/JMP
+    bool is_idle_loop_skipping_enabled = true;
 
     // At normal speed, this will remain accurate for at least 300 millennia
     uint64_t cycle_count = 0;
+    uint64_t instr_count = 0;
+
+    // Running hash of every bus access not covered by the page map (i.e. of
+    // those which may have side effects; compiled code builds only), for
+    // comparing compiled code against the interpreter
+    bool is_bus_traced = false;
+    uint64_t bus_trace = 0;
+
+    void trace_bus(uint16_t addr, uint8_t data, bool is_write)
+    {
+#ifdef NOS_CPU_COMPILED_CODE
+        if(is_bus_traced)
+        {
+            uint64_t access = (cycle_count << 25) | (uint64_t(is_write) << 24) |
+                              (addr << 8) | data;
+            bus_trace = (bus_trace ^ access) * 0x100000001B3ULL;
+        }
+#else
+        (void)addr; (void)data; (void)is_write;
+#endif
+    }
+
+    // The PPU is run lazily ('catch-up'); its cycles are accumulated here and
+    // only executed once the CPU is about to observe or affect its state, or
+    // once the PPU itself is predicted to change the NMI line/frame buffers
+    uint32_t ppu_cycles_pending = 0;
+    uint32_t ppu_cycles_until_event = 0;
+
+    void sync_ppu()
+    {
+        ppu.catch_up(ppu_cycles_pending);
+        ppu_cycles_pending = 0;
+        ppu_cycles_until_event = ppu.cycles_until_event();
+
+        // Publish the audio of a frame just ended along with its pixels
+        if(shared_bus.get_frame_count() != apu.get_frame_count())
+            sync_apu();
+    }
+
+    void run_ppu(uint32_t cycles)
+    {
+        ppu_cycles_pending += cycles;
+        if(ppu_cycles_pending >= ppu_cycles_until_event)
+            sync_ppu();
+    }
+
+    // Likewise for the APU, in CPU cycle phases: it is only caught up before
+    // its registers are accessed, at frame sequencer steps (which may assert
+    // the IRQ line), when streamed samples are due and once a frame has ended
+    uint32_t apu_phases_pending = 0;
+    uint32_t apu_phases_until_event = 0;
+
+    void sync_apu()
+    {
+        apu.catch_up(apu_phases_pending);
+        apu_phases_pending = 0;
+        apu_phases_until_event = apu.phases_until_event();
+    }
+
+    void run_apu(uint32_t phases)
+    {
+        apu_phases_pending += phases;
+        if(apu_phases_pending >= apu_phases_until_event)
+            sync_apu();
+    }
 
     void phase_one()
     {
         ++cycle_count;
 
-        ppu.execute_cycle();
-        ppu.execute_cycle();
+        run_ppu(2);
         
-        apu.process_frame_cpu_phase();
+        run_apu(1);
         
         // End-of-instruction poll result (treat every cycle as the last)
         should_interrupt = signal_irq || signal_nmi;
@@ -127,11 +350,15 @@ class CPU
 
     void phase_two()
     {
-        ppu.execute_cycle();
+        run_ppu(1);
+
+        run_apu(1);
 
-        apu.process_frame_cpu_phase();
-        apu.tick(cycle_count % 2);
+        poll_interrupt_lines();
+    }
 
+    void poll_interrupt_lines()
+    {
         // IRQ level-detector/NMI edge-detector results
         if(!ignore_irq_change)
         {
@@ -160,7 +387,9 @@ class CPU
         uint8_t data = 0;
         switch(addr)
         {
-            case(0x15): data = apu.read_reg_status();  break;
+            case(0x15): sync_apu();
+                        data = apu.read_reg_status();
+                        break;
             case(0x16): data = port_one.read_bit();    break;
             case(0x17): data = port_two.read_bit();    break;
             default:    data = 0;                      break;
@@ -228,13 +457,39 @@ class CPU
     {
         phase_one();
 
+        const uint8_t* page = shared_bus.cpu_page_read[addr >> 8];
+        uint8_t data = (page ? page[addr % 0x100] : read_handler(addr));
+        if(!page) trace_bus(addr, data, false);
+
+        phase_two();
+
+        return data;
+    }
+
+    void mem_write(uint16_t addr, uint8_t data)
+    {
+        phase_one();
+
+        uint8_t* page = shared_bus.cpu_page_write[addr >> 8];
+        if(page) page[addr % 0x100] = data;
+        else     write_handler(addr, data);
+        if(!page) trace_bus(addr, data, true);
+
+        phase_two();
+    }
+
+    // Accesses not covered by the page map
+    uint8_t read_handler(uint16_t addr)
+    {
         uint8_t data = 0;
         auto [ mem_hw, hw_addr ] = parse_addr(addr);
         switch(mem_hw)
         {
             case(Mem_HW::RAM):     data = ram[hw_addr];
                                    break;
-            case(Mem_HW::PPU_REG): data = ppu.read_reg(hw_addr);
+            case(Mem_HW::PPU_REG): sync_ppu();
+                                   data = ppu.read_reg(hw_addr);
+                                   sync_ppu();
                                    break;
             case(Mem_HW::IO_REG):  data = read_reg(hw_addr);
                                    break;
@@ -242,29 +497,30 @@ class CPU
                                    break;
         }
 
-        phase_two();
-
         return data;
     }
 
-    void mem_write(uint16_t addr, uint8_t data)
+    void write_handler(uint16_t addr, uint8_t data)
     {
-        phase_one();
-        
         auto [ mem_hw, hw_addr ] = parse_addr(addr);
         switch(mem_hw)
         {
             case(Mem_HW::RAM):     ram[hw_addr] = data;             
                                    break;
-            case(Mem_HW::PPU_REG): ppu.write_reg(hw_addr, data);   
+            case(Mem_HW::PPU_REG): sync_ppu();
+                                   ppu.write_reg(hw_addr, data);
+                                   sync_ppu();
                                    break;
-            case(Mem_HW::IO_REG):  write_reg(hw_addr, data);
+            case(Mem_HW::IO_REG):  sync_apu();
+                                   write_reg(hw_addr, data);
+                                   sync_apu();
                                    break;
-            case(Mem_HW::CART):    cart.cpu_write(shared_bus, hw_addr, data);       
+            case(Mem_HW::CART):    sync_ppu();  // Mapper may affect PPU
+                                   shared_bus.log_ppu_input(Ppu_Input::WRITE,
+                                                            hw_addr, data);
+                                   cart.cpu_write(shared_bus, hw_addr, data);
                                    break;
         }
-
-        phase_two();
     }
 
     void exec_oam_dma(uint8_t data)
@@ -275,15 +531,198 @@ class CPU
         mem_read(PC);
         if(cycle_count % 2) mem_read(PC);
 
-        for(unsigned int i = 0; i < 0x100; ++i)
+        // Bulk copy, unless reading the source page has side effects (it is
+        // not covered by the page map) or rendering may use OAM meanwhile
+        const uint8_t* page = shared_bus.cpu_page_read[data];
+        sync_ppu();
+        if(page && ppu.is_oam_idle(ppu_ticks_per_cpu * 0x200))
         {
-            uint8_t value = mem_read((data << 8) | i);
-            mem_write(0x2004, value);
+            exec_oam_dma_bulk(page);
+        }
+        else
+        {
+            for(unsigned int i = 0; i < 0x100; ++i)
+            {
+                uint8_t value = mem_read((data << 8) | i);
+                mem_write(0x2004, value);
+            }
         }
 
         is_oam_dma_active = false;
     }
 
+    // Equivalent to the per-byte transfer from the given page, provided that
+    // its reads have no side effects and that the PPU doesn't touch OAM in
+    // the meantime. The bus cycles then only matter to the APU and the
+    // interrupt lines, which only need to be polled once the PPU is caught up
+    // (the NMI line changes at most once within 1536 PPU cycles). The final
+    // write goes through mem_write(), so that its interrupt poll sees the
+    // result of the previous cycle as usual.
+    void exec_oam_dma_bulk(const uint8_t* page)
+    {
+        for(unsigned int i = 0; i < 0xFF; ++i)
+        {
+            advance_idle_cycles(2);
+            ppu.write_reg(0x4, page[i]);
+            trace_bus(0x2004, page[i], true);
+        }
+        advance_idle_cycles(1);
+
+        sync_ppu();
+        poll_interrupt_lines();
+
+        mem_write(0x2004, page[0xFF]);
+    }
+
+    using Exec = bool (Basic_CPU::*)(uint16_t operand);
+
+    // The exec_prefetched<>() instantiation for each opcode
+    static Exec exec_for(uint8_t opcode)
+    {
+        static constexpr Exec exec_table[0x100] =
+        {
+#define NOS_OPCODE_EXEC(code, i, am) &Basic_CPU::exec_prefetched<i,am>,
+            NOS_OPCODE_MAP(NOS_OPCODE_EXEC)
+#undef NOS_OPCODE_EXEC
+        };
+        return exec_table[opcode];
+    }
+
+    // Instructions in PRG-ROM, decoded a basic block at a time ahead of
+    // execution (if NOS_CPU_DECODE_CACHE is defined): each entry holds the
+    // exec_prefetched<>() instantiation for its opcode, its operand bytes
+    // assembled, and its size (also its number of fetch cycles, which are run
+    // at once). The instructions of a block follow each other within the
+    // cache page, as it is indexed by address
+    struct Cached_Instr
+    {
+        Exec exec;
+        uint16_t operand;
+        uint8_t size;
+        bool is_block_end;      // Control flow, or the last one on its page
+    };
+
+    Decode_Cache<Cached_Instr> decode_cache;
+
+    // Precondition: src is the read-only memory mapped at the page of addr
+    void decode_block(uint16_t addr, const uint8_t* src)
+    {
+        Cached_Instr* prev = nullptr;
+        while(true)
+        {
+            uint8_t page_addr = addr % 0x100;
+            uint8_t opcode = src[page_addr];
+            const Opcode_Info& info = opcode_info[opcode];
+            unsigned int size = 1 + operand_size(info.addr_mode);
+
+            // Bytes on the next page may belong to a different bank
+            if(page_addr + size > 0x100)
+            {
+                if(prev) prev->is_block_end = true;
+                break;
+            }
+
+            uint16_t operand = 0;
+            if(size > 1) operand |= src[page_addr + 1];
+            if(size > 2) operand |= (src[page_addr + 2] << 8);
+            bool is_block_end = (is_control_flow(info.instr) ||
+                                 (page_addr + size == 0x100));
+
+            Cached_Instr& instr = decode_cache.insert(addr, src);
+            instr = { exec_for(opcode), operand, uint8_t(size),
+                      is_block_end };
+
+            if(is_block_end) break;
+            prev = &instr;
+            addr += size;
+        }
+    }
+
+    // Runs the cached instructions from PC to the end of their block (or
+    // until an interrupt is serviced or the page map changes); returns false
+    // if PC isn't in PRG-ROM
+    bool execute_cached_block()
+    {
+        const uint8_t* src = shared_bus.cpu_page_read[PC >> 8];
+        bool is_read_only = (src && !shared_bus.cpu_page_write[PC >> 8]);
+        if(!is_read_only)
+            return false;
+
+        const Cached_Instr* instr = decode_cache.find(PC, src);
+        if(!instr)
+        {
+            decode_block(PC, src);
+
+            // Still null if the instruction crosses into the next page
+            instr = decode_cache.find(PC, src);
+            if(!instr) return false;
+        }
+
+        uint32_t map_generation = shared_bus.cpu_map_generation;
+        while(true)
+        {
+            bool is_block_end = instr->is_block_end;
+            bool is_interrupted = (this->*(instr->exec))(instr->operand);
+            if(is_block_end || is_interrupted ||
+               (shared_bus.cpu_map_generation != map_generation))
+                return true;
+
+            instr += instr->size;
+        }
+    }
+
+    // Equivalent to the given number of bus cycles fetching from PRG-ROM
+    // (which has no side effects). Unless the PPU or APU is due to be caught
+    // up meanwhile, the interrupt lines stay put, so that polling them once
+    // gives the result of every cycle but the first
+    void run_fetch_cycles(unsigned int cycles)
+    {
+        bool is_ppu_idle = (ppu_cycles_pending + (ppu_ticks_per_cpu * cycles) <
+                            ppu_cycles_until_event);
+        bool is_apu_idle = (apu_phases_pending + (2 * cycles) <
+                            apu_phases_until_event);
+        if(!is_ppu_idle || !is_apu_idle)
+        {
+            for(unsigned int i = 0; i < cycles; ++i)
+            {
+                phase_one();
+                phase_two();
+            }
+            return;
+        }
+
+        advance_idle_cycles(cycles);
+        if(cycles == 1) should_interrupt = signal_irq || signal_nmi;
+        poll_interrupt_lines();
+        if(cycles > 1)  should_interrupt = signal_irq || signal_nmi;
+    }
+
+    // Operand bytes of the current instruction, if fetched ahead of it
+    // (see exec_prefetched())
+    bool is_operand_prefetched = false;
+    uint16_t prefetched_operand = 0;
+
+    // Instruction stream fetch
+    uint8_t fetch()
+    {
+        return mem_read(PC++);
+    }
+
+    uint8_t fetch_operand_byte()
+    {
+        return (is_operand_prefetched ? prefetched_operand : fetch());
+    }
+
+    uint16_t fetch_operand_word()
+    {
+        if(is_operand_prefetched)
+            return prefetched_operand;
+
+        uint8_t lsb = fetch();
+        uint8_t msb = fetch();
+        return (msb << 8) | lsb;
+    }
+
     uint16_t effective_SP()
     {
         return (0x100U | SP);
@@ -292,15 +731,59 @@ class CPU
 
 
     // Operand handling
+
+    // Dummy class template used for overload-based dispatch of addressing
+    // modes (explicitly specializing member templates of a class template
+    // is illegal)
+    template<AddrMode> struct AddrMode_Tag {};
    
     template<AddrMode am>
-    uint8_t read_data(void);
+    uint8_t read_data() { return read_data(AddrMode_Tag<am>{}); }
     
     template<AddrMode am>
-    void write_data(uint8_t);
+    void write_data(uint8_t data) { write_data(AddrMode_Tag<am>{}, data); }
     
     template<AddrMode am>
-    void get_effective_operand();
+    void get_effective_operand() { get_effective_operand(AddrMode_Tag<am>{}); }
+
+    template<AddrMode am>
+    uint8_t read_data(AddrMode_Tag<am>);
+    uint8_t read_data(AddrMode_Tag<Acc>);
+    uint8_t read_data(AddrMode_Tag<Imm>);
+    uint8_t read_data(AddrMode_Tag<In>);
+
+    // For the Imp addressing mode, 'reading' makes no sense
+    uint8_t read_data(AddrMode_Tag<Imp>) = delete;
+
+    template<AddrMode am>
+    void write_data(AddrMode_Tag<am>, uint8_t);
+    void write_data(AddrMode_Tag<Acc>, uint8_t);
+
+    // For the Imp/Imm addressing modes, 'writing' makes no sense
+    void write_data(AddrMode_Tag<Imp>, uint8_t) = delete;
+    void write_data(AddrMode_Tag<Imm>, uint8_t) = delete;
+
+    // Writing with these addressing modes (the non-__S variants, i.e. not
+    // safeguarded against page-boundary optimisation) is forbidden
+    void write_data(AddrMode_Tag<AbX>, uint8_t) = delete;
+    void write_data(AddrMode_Tag<AbY>, uint8_t) = delete;
+    void write_data(AddrMode_Tag<InY>, uint8_t) = delete;
+
+    void get_effective_operand(AddrMode_Tag<Imp>);
+    void get_effective_operand(AddrMode_Tag<Acc>);
+    void get_effective_operand(AddrMode_Tag<Imm>);
+    void get_effective_operand(AddrMode_Tag<ZP>);
+    void get_effective_operand(AddrMode_Tag<ZPX>);
+    void get_effective_operand(AddrMode_Tag<ZPY>);
+    void get_effective_operand(AddrMode_Tag<Ab>);
+    void get_effective_operand(AddrMode_Tag<AbX>);
+    void get_effective_operand(AddrMode_Tag<AbXS>);
+    void get_effective_operand(AddrMode_Tag<AbY>);
+    void get_effective_operand(AddrMode_Tag<AbYS>);
+    void get_effective_operand(AddrMode_Tag<In>);
+    void get_effective_operand(AddrMode_Tag<InX>);
+    void get_effective_operand(AddrMode_Tag<InY>);
+    void get_effective_operand(AddrMode_Tag<InYS>);
 
     // Helper functions
     void get_effective_operand_ZP_ (uint8_t);
@@ -322,14 +805,7 @@ class CPU
     // Common helper function 
     void assign_zn_flags(uint8_t data)
     {
-        PS &= ~(PS_Flags::ZERO | 
-                PS_Flags::NEGATIVE);
-
-        if(data == 0)
-            PS |= PS_Flags::ZERO;
-
-        if(data & (1U << 7))
-            PS |= PS_Flags::NEGATIVE;
+        flag_nz = data;
     }
 
 
@@ -338,20 +814,15 @@ class CPU
        
     void helper_ADC(uint8_t data)
     {
-        bool carry = (PS & PS_Flags::CARRY);
-        uint16_t sum = A + data + (carry ? 1U : 0);
+        uint16_t sum = A + data + (flag_c ? 1U : 0);
         
-        PS &= ~PS_Flags::CARRY; 
-        if(sum > 0xFF)
-            PS |= PS_Flags::CARRY;
+        flag_c = (sum > 0xFF);
         
         assign_zn_flags(sum % 0x100);
        
         // Assign OVERFLOW (V) flag
         // http://forums.nesdev.com/viewtopic.php?t=6331
-        PS &= ~PS_Flags::OVERFLOW;
-        if((A ^ sum) & (data ^ sum) & 1U << 7)
-            PS |= PS_Flags::OVERFLOW;
+        flag_v = (A ^ sum) & (data ^ sum);
 
         A = (sum % 0x100);
     }
@@ -359,8 +830,9 @@ class CPU
     // I'm aware that using template-based opcode dispatch leads to a 
     // considerably bigger binary size and heavy cache missing with only
     // the mild benefit of improved inlining; I implemented it this way due
-    // to pattern-matching being expressed more easily, and since the CPU
-    // isn't a performance bottleneck at the moment, this can be changed later.
+    // to pattern-matching being expressed more easily. Defining
+    // NOS_CPU_SWITCH_DISPATCH at build time replaces the member function
+    // pointer table with a single switch over the same op<>() instantiations.
 
     template<AddrMode am>
     void opcode(Instr_Tag<ADC>) 
@@ -402,8 +874,7 @@ class CPU
     
     void helper_compare(uint8_t reg, uint8_t data)
     {
-        PS &= ~PS_Flags::CARRY;
-        if(reg >= data) PS |= PS_Flags::CARRY;
+        flag_c = (reg >= data);
 
         assign_zn_flags(reg - data);
     }
@@ -462,9 +933,7 @@ class CPU
     {
         uint8_t data = read_data<am>();
         
-        PS &= ~PS_Flags::CARRY;
-        if(data & (1U << 7))
-            PS |= PS_Flags::CARRY;
+        flag_c = (data & (1U << 7));
 
         if(am != Acc) 
             write_data<am>(data);
@@ -479,9 +948,7 @@ class CPU
     {
         uint8_t data = read_data<am>();
         
-        PS &= ~PS_Flags::CARRY;
-        if(data & (1U << 0))
-            PS |= PS_Flags::CARRY;
+        flag_c = (data & (1U << 0));
 
         if(am != Acc) 
             write_data<am>(data);
@@ -495,11 +962,9 @@ class CPU
     void opcode(Instr_Tag<ROL>)
     {
         uint8_t data = read_data<am>();
-        bool prev_carry = (PS & PS_Flags::CARRY);
+        bool prev_carry = flag_c;
 
-        PS &= ~PS_Flags::CARRY;
-        if(data & (1U << 7))
-            PS |= PS_Flags::CARRY;
+        flag_c = (data & (1U << 7));
 
         if(am != Acc) 
             write_data<am>(data);
@@ -514,11 +979,9 @@ class CPU
     void opcode(Instr_Tag<ROR>)
     {
         uint8_t data = read_data<am>();
-        bool prev_carry = (PS & PS_Flags::CARRY);
+        bool prev_carry = flag_c;
 
-        PS &= ~PS_Flags::CARRY;
-        if(data & (1U << 0))
-            PS |= PS_Flags::CARRY;
+        flag_c = (data & (1U << 0));
 
         if(am != Acc) 
             write_data<am>(data);
@@ -534,32 +997,36 @@ class CPU
     // BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ, JMP, JSR, RTS, BRK, RTI, NOP
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BPL>) { should_branch = !(PS & PS_Flags::NEGATIVE); }
+    void opcode(Instr_Tag<BPL>) { should_branch = !(flag_nz & 0x180U); }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BMI>) { should_branch =  (PS & PS_Flags::NEGATIVE); }
+    void opcode(Instr_Tag<BMI>) { should_branch =  (flag_nz & 0x180U); }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BVC>) { should_branch = !(PS & PS_Flags::OVERFLOW); }
+    void opcode(Instr_Tag<BVC>) { should_branch = !(flag_v & (1U << 7)); }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BVS>) { should_branch =  (PS & PS_Flags::OVERFLOW); }
+    void opcode(Instr_Tag<BVS>) { should_branch =  (flag_v & (1U << 7)); }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BCC>) { should_branch = !(PS & PS_Flags::CARRY); }   
+    void opcode(Instr_Tag<BCC>) { should_branch = !flag_c; }   
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BCS>) { should_branch =  (PS & PS_Flags::CARRY); }
+    void opcode(Instr_Tag<BCS>) { should_branch =  flag_c; }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BNE>) { should_branch = !(PS & PS_Flags::ZERO); }
+    void opcode(Instr_Tag<BNE>) { should_branch = (flag_nz % 0x100) != 0; }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<BEQ>) { should_branch =  (PS & PS_Flags::ZERO); }
+    void opcode(Instr_Tag<BEQ>) { should_branch = (flag_nz % 0x100) == 0; }
     
     template<AddrMode am>
     void opcode(Instr_Tag<JMP>) 
     {
+        // JMP * (see skip_idle_loop())
+        is_idle_loop_candidate = (effective_operand == uint16_t(PC - 3));
+        idle_loop_jump_addr = PC - 3;
+
         // Executed concurrently with previous cycle 
         PC = effective_operand; 
     }
@@ -626,7 +1093,7 @@ class CPU
             ? (signal_nmi = false, IV_Addr::NMI)
             : IV_Addr::IRQ);
 
-        uint8_t flags_to_push = PS | PS_Flags::UNUSED;
+        uint8_t flags_to_push = get_PS() | PS_Flags::UNUSED;
         if(!is_interrupt) 
             flags_to_push |= PS_Flags::BREAK;
         mem_write(effective_SP(), flags_to_push);
@@ -655,7 +1122,7 @@ class CPU
 
         uint8_t flags_pulled = mem_read(effective_SP());
         flags_pulled &= ~(PS_Flags::UNUSED | PS_Flags::BREAK);
-        PS = flags_pulled;
+        set_PS(flags_pulled);
         ++SP;
 
         uint8_t lsb = mem_read(effective_SP());
@@ -673,10 +1140,10 @@ class CPU
     // CLC, SEC, CLD, SED, CLI, SEI, CLV, BIT
     
     template<AddrMode am>
-    void opcode(Instr_Tag<CLC>) { PS &= ~PS_Flags::CARRY; }
+    void opcode(Instr_Tag<CLC>) { flag_c = false; }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<SEC>) { PS |=  PS_Flags::CARRY; }
+    void opcode(Instr_Tag<SEC>) { flag_c = true; }
     
     template<AddrMode am>
     void opcode(Instr_Tag<CLD>) { PS &= ~PS_Flags::DECIMAL; }
@@ -691,19 +1158,17 @@ class CPU
     void opcode(Instr_Tag<SEI>) { PS |=  PS_Flags::IRQ_DISABLE; }
     
     template<AddrMode am>
-    void opcode(Instr_Tag<CLV>) { PS &= ~PS_Flags::OVERFLOW; }
+    void opcode(Instr_Tag<CLV>) { flag_v = 0; }
     
     template<AddrMode am>
     void opcode(Instr_Tag<BIT>)
     {
         uint8_t data = read_data<am>();
 
-        PS &= ~(PS_Flags::ZERO);
-        if((data & A) == 0)
-            PS |= PS_Flags::ZERO;
-
-        PS &= ~(PS_Flags::OVERFLOW | PS_Flags::NEGATIVE);
-        PS |= ((PS_Flags::OVERFLOW | PS_Flags::NEGATIVE) & data);
+        // Z from (data & A), N from bit 7 of data (moved to bit 8, in case
+        // it is cleared by A), V from bit 6 of data
+        flag_nz = (data & A) | ((data & (1U << 7)) << 1);
+        flag_v = (data << 1);
     }
 
 
@@ -842,7 +1307,7 @@ class CPU
     template<AddrMode am>
     void opcode(Instr_Tag<PHP>)
     {
-        uint8_t flags_to_push = PS | PS_Flags::UNUSED | PS_Flags::BREAK;
+        uint8_t flags_to_push = get_PS() | PS_Flags::UNUSED | PS_Flags::BREAK;
         mem_write(effective_SP(), flags_to_push);
         --SP;
     }
@@ -855,7 +1320,7 @@ class CPU
 
         uint8_t flags_pulled = mem_read(effective_SP());
         flags_pulled &= ~(PS_Flags::BREAK | PS_Flags::UNUSED);
-        PS = flags_pulled;
+        set_PS(flags_pulled);
     }
 
 
@@ -960,7 +1425,7 @@ class CPU
             A = 0;
             X = 0;
             Y = 0;
-            PS = PS_Flags::BREAK | PS_Flags::UNUSED;
+            set_PS(PS_Flags::BREAK | PS_Flags::UNUSED);
             SP = 0;
             PC = 0;
         }
@@ -1017,9 +1482,128 @@ class CPU
             mem_read((msb << 8) | (lsb + displacement));
         }
 
+        // Back to a load just before the branch (see skip_idle_loop())
+        is_idle_loop_candidate = ((displacement == -4) || (displacement == -5));
+        idle_loop_jump_addr = PC - 2;
+
         PC = new_PC;
     }
 
+    // Equivalent to the given number of bus cycles, provided that these don't
+    // access anything with side effects; the interrupt lines are not polled
+    // (and the PPU not caught up), which is left to the caller
+    void advance_idle_cycles(uint64_t cycles)
+    {
+        cycle_count += cycles;
+        run_apu(2 * cycles);
+        ppu_cycles_pending += ppu_ticks_per_cpu * cycles;
+    }
+
+    // Games often spin in a polling loop until an interrupt handler or the
+    // PPU changes what they poll; when PC has just been branched back to one:
+    //     L: JMP L
+    //     L: LDA/BIT <zp/abs RAM>   B__ L      (BPL/BMI/BNE/BEQ)
+    //     L: LDA/BIT $2002          BPL L      (i.e. waiting for vblank)
+    // further iterations are skipped in bulk (only performing their cycles)
+    // for as long as the result polled provably stays the same: no interrupt
+    // can be signalled (the NMI line only changes at PPU events, the IRQ line
+    // at APU frame sequencer steps) and the PPU isn't caught up (so $2002 bit
+    // 7 stays put, and repeated reads of it have no further side effects).
+    // The loop is then left to the interpreter for its exit iteration
+    void skip_idle_loop()
+    {
+        if(!is_idle_loop_skipping_enabled ||
+           signal_irq || signal_nmi || is_oam_dma_active)
+            return;
+
+        // A taken branch's extra cycle doesn't poll the interrupt lines, so
+        // an NMI edge or IRQ on it isn't signalled yet (but will be after
+        // the next instruction)
+        if((line_nmi_low() && !prev_line_nmi_low) ||
+           (line_irq_low() && !(PS & PS_Flags::IRQ_DISABLE)))
+            return;
+
+        const uint8_t* page = shared_bus.cpu_page_read[PC >> 8];
+        bool is_read_only = (page && !shared_bus.cpu_page_write[PC >> 8]);
+        if(!is_read_only || ((PC % 0x100) + 5 > 0x100))
+            return;
+        const uint8_t* code = page + (PC % 0x100);
+
+        uint64_t iteration_cycles = 0;
+        uint64_t iteration_instrs = 0;
+        if((code[0] == 0x4C) && (((code[2] << 8) | code[1]) == PC) &&
+           (idle_loop_jump_addr == PC))
+        {
+            iteration_cycles = 3;
+            iteration_instrs = 1;
+        }
+        else
+        {
+            // LDA/BIT
+            bool is_zp = ((code[0] == 0xA5) || (code[0] == 0x24));
+            bool is_ab = ((code[0] == 0xAD) || (code[0] == 0x2C));
+            if(!is_zp && !is_ab)
+                return;
+
+            // The branch just taken must be the one following the load
+            unsigned int load_size = (is_zp ? 2 : 3);
+            uint16_t addr = (is_zp ? code[1] : ((code[2] << 8) | code[1]));
+            uint8_t branch = code[load_size];
+            int displacement = -int(load_size + 2);
+            if((idle_loop_jump_addr != uint16_t(PC + load_size)) ||
+               (code[load_size + 1] != uint8_t(displacement)))
+                return;
+
+            // BPL/BMI, BNE/BEQ
+            bool is_n_branch = ((branch == 0x10) || (branch == 0x30));
+            bool is_z_branch = ((branch == 0xD0) || (branch == 0xF0));
+            bool is_memory = (shared_bus.cpu_page_read [addr >> 8] &&
+                              shared_bus.cpu_page_write[addr >> 8]);
+            bool is_ppu_status = ((addr >= 0x2000) && (addr < 0x4000) &&
+                                  (addr % 8 == 2));
+            // Reading $2002 with bit 7 set clears it, hence BPL only
+            if(!((is_memory && (is_n_branch || is_z_branch)) ||
+                 (is_ppu_status && (branch == 0x10))))
+                return;
+
+            // The branch may have been taken on a result polled before an
+            // interrupt handler ran, so check that the next one takes it too
+            uint8_t value = (is_memory
+                             ? shared_bus.cpu_page_read[addr >> 8][addr % 0x100]
+                             : (ppu.is_vblank_flag_set() ? 0x80 : 0x00));
+            bool is_bit = ((code[0] == 0x24) || (code[0] == 0x2C));
+            bool is_zero = ((is_bit ? (value & A) : value) == 0);
+            bool is_negative = (value & 0x80);
+            bool is_taken = ((branch == 0x10) ? !is_negative :
+                             (branch == 0x30) ?  is_negative :
+                             (branch == 0xD0) ? !is_zero     :
+                                                 is_zero);
+            if(!is_taken)
+                return;
+
+            uint16_t branch_end = PC + load_size + 2;
+            bool is_page_crossed = ((branch_end >> 8) != (PC >> 8));
+            unsigned int branch_cycles = 3 + (is_page_crossed ? 1 : 0);
+            iteration_cycles = (load_size + 1) + branch_cycles;
+            iteration_instrs = 2;
+        }
+
+        // The PPU is caught up once (ppu_cycles_until_event) is reached
+        uint64_t ppu_cycles = ppu_cycles_until_event - ppu_cycles_pending - 1;
+        uint64_t max_cycles = ppu_cycles / ppu_ticks_per_cpu;
+        if(!(PS & PS_Flags::IRQ_DISABLE))
+        {
+            // The APU is caught up once (apu_phases_until_event) is reached
+            uint64_t irq_cycles = (apu_phases_until_event -
+                                   apu_phases_pending - 1) / 2;
+            if(irq_cycles < max_cycles) max_cycles = irq_cycles;
+        }
+
+        uint64_t iterations = max_cycles / iteration_cycles;
+        advance_idle_cycles(iterations * iteration_cycles);
+        instr_count += iterations * iteration_instrs;
+    }
+
 
     template<Instr i, AddrMode am>
     void op()
@@ -1033,171 +1617,1159 @@ class CPU
             perform_branch();
     }
 
+    // Returns whether an interrupt was serviced (i.e. whether execution
+    // continues somewhere other than PC as left by the instruction)
+    bool end_instruction()
+    {
+        ++instr_count;
+
+        if(is_idle_loop_candidate)
+        {
+            is_idle_loop_candidate = false;
+            if(!should_interrupt) skip_idle_loop();
+        }
+
+        if(!should_interrupt)
+            return false;
+
+        // Dummy read the next opcode and discard it (inserting BRK into the
+        // instruction register) to allow overlapped final cycle of previous
+        // instruction to complete, if necessary
+        mem_read(PC);
+
+        is_interrupt = true;
+        op<BRK,Imp>();
+        is_interrupt = false;
+        return true;
+    }
+
+    // Executes the instruction at PC given its operand bytes (assembled)
+    // rather than fetching them, only running the fetch cycles; returns
+    // whether an interrupt was serviced
+    template<Instr i, AddrMode am>
+    bool exec_prefetched(uint16_t operand)
+    {
+        constexpr unsigned int size = 1 + operand_size(am);
+        run_fetch_cycles(size);
+        PC += size;
+
+        prefetched_operand = operand;
+        is_operand_prefetched = true;
+        op<i,am>();
+        is_operand_prefetched = false;
+
+        return end_instruction();
+    }
+
+#ifdef NOS_CPU_JIT
+    // Dynamic recompiler: once a basic block in PRG-ROM has been entered
+    // jit_hot_threshold times, it is translated into x86-64 code. Official
+    // instructions which only access work RAM and memory in the page map are
+    // translated into native code operating on the registers/flags in place,
+    // whose bus cycles are only summed up, to be committed to cycle_count and
+    // the PPU/APU's pending cycles at once. Everything else (I/O and cartridge
+    // registers, the I flag, interrupts) is handed to the interpreter through
+    // jit_interpret(), as is an access found to fall outside the page map at
+    // run time, so that the PPU/APU are only caught up around those. Native
+    // code only runs while no interrupt is pending or can be signalled and
+    // neither the PPU nor the APU is due to be caught up over its cycles
+    // (is_jit_quiet()), as every bus cycle then merely advances counters; the
+    // timing thus remains exact. Code in RAM/PRG-RAM (which may be
+    // self-modifying) is always interpreted, and a block is left early once
+    // an interrupt is serviced or the page map changes
+    static constexpr unsigned int jit_hot_threshold = 16;
+
+    using Asm = X64_Code_Buffer;
+
+    struct JIT_Block
+    {
+        Asm::Block code = nullptr;
+        unsigned int hit_count = 0;
+        uint32_t max_cycles = 0;    // Of its native code before interpreting
+    };
+
+    X64_Code_Buffer jit_code;
+    Decode_Cache<JIT_Block> jit_cache;
+
+    struct JIT_Instr
+    {
+        uint16_t addr;
+        uint8_t opcode;
+        uint16_t operand;
+        unsigned int cycles;        // In native code, without page crossings
+        unsigned int max_cycles;    // 0 if left to the interpreter
+    };
+
+    enum class JIT_Access { NONE, READ, WRITE, MODIFY };
+
+    static JIT_Access jit_access(Instr i)
+    {
+        switch(i)
+        {
+            case(ADC): case(SBC): case(AND): case(ORA): case(EOR): case(CMP):
+            case(CPX): case(CPY): case(BIT): case(LDA): case(LDX): case(LDY):
+                return JIT_Access::READ;
+            case(STA): case(STX): case(STY):
+                return JIT_Access::WRITE;
+            case(INC): case(DEC): case(ASL): case(LSR): case(ROL): case(ROR):
+                return JIT_Access::MODIFY;
+            default:
+                return JIT_Access::NONE;
+        }
+    }
+
+    // Counts the bus cycles of an instruction as the interpreter performs
+    // them, if it is translated into native code
+    static void jit_count_cycles(JIT_Instr& instr)
+    {
+        const Opcode_Info& info = opcode_info[instr.opcode];
+        AddrMode am = info.addr_mode;
+        instr.cycles = 0;
+        instr.max_cycles = 0;
+
+        // Opcode/operand fetches and dummy reads
+        unsigned int mode_cycles = 0;
+        switch(am)
+        {
+            case(Imp): case(Acc): case(Imm): case(ZP):
+                mode_cycles = 2;
+                break;
+            case(ZPX): case(ZPY): case(Ab): case(AbX): case(AbY):
+                mode_cycles = 3;
+                break;
+            case(AbXS): case(AbYS): case(InY):
+                mode_cycles = 4;
+                break;
+            case(In): case(InX): case(InYS):
+                mode_cycles = 5;
+                break;
+        }
+
+        JIT_Access access = jit_access(info.instr);
+        if(access != JIT_Access::NONE)
+        {
+            // The I/O registers (and some cartridge space) lie on these pages
+            auto is_io_page = [](unsigned int page)
+            {
+                return ((page >= 0x20) && (page <= 0x40));
+            };
+            unsigned int page = instr.operand >> 8;
+            bool is_indexed = ((am == AbX) || (am == AbXS) ||
+                               (am == AbY) || (am == AbYS));
+            if(((am == Ab) || is_indexed) && is_io_page(page))
+                return;
+            if(is_indexed && is_io_page((page + 1) % 0x100))
+                return;
+
+            bool is_memory = ((am != Imm) && (am != Acc));
+            unsigned int access_cycles =
+                ((access == JIT_Access::MODIFY) ? 3 : 1);
+            instr.cycles = mode_cycles + (is_memory ? access_cycles : 0);
+
+            bool may_cross = ((access == JIT_Access::READ) &&
+                              ((am == AbX) || (am == AbY) || (am == InY)));
+            instr.max_cycles = instr.cycles + (may_cross ? 1 : 0);
+            return;
+        }
+
+        switch(info.instr)
+        {
+            case(TAX): case(TAY): case(TXA): case(TYA): case(TSX): case(TXS):
+            case(INX): case(INY): case(DEX): case(DEY): case(CLC): case(SEC):
+            case(CLD): case(SED): case(CLV):
+                instr.cycles = 2;
+                break;
+            case(NOP):
+                if(am == Imp) instr.cycles = 2;
+                break;
+            case(PHA):
+                instr.cycles = 3;
+                break;
+            case(PLA):
+                instr.cycles = 4;
+                break;
+            case(JSR): case(RTS):
+                instr.cycles = 6;
+                break;
+            case(JMP):
+                if(am == Ab) instr.cycles = 3;
+                break;
+            case(BPL): case(BMI): case(BVC): case(BVS): case(BCC): case(BCS):
+            case(BNE): case(BEQ):
+            {
+                // One more cycle if taken, and another if crossing a page
+                int displacement = ((instr.operand + 0x80) % 0x100) - 0x80;
+                uint16_t next_PC = instr.addr + 2;
+                uint16_t new_PC = next_PC + displacement;
+                instr.cycles = 2;
+                instr.max_cycles = (((next_PC >> 8) == (new_PC >> 8)) ? 3 : 4);
+                return;
+            }
+            default:
+                break;
+        }
+        instr.max_cycles = instr.cycles;
+    }
+
+    // Whether no interrupt is pending or can be signalled (the interrupt
+    // lines staying as they are), and neither the PPU nor the APU is due to be
+    // caught up, over the given number of cycles
+    bool is_jit_quiet(uint32_t cycles)
+    {
+        return (!should_interrupt && !signal_irq && !signal_nmi &&
+                !is_oam_dma_active &&
+                (!line_irq_low() || (PS & PS_Flags::IRQ_DISABLE)) &&
+                (line_nmi_low() == prev_line_nmi_low) &&
+                (ppu_cycles_pending + (ppu_ticks_per_cpu * cycles) <
+                 ppu_cycles_until_event) &&
+                (apu_phases_pending + (2 * cycles) < apu_phases_until_event));
+    }
+
+    // Called by compiled code to run the instruction at PC through the
+    // interpreter, once the cycles of the native code before it have been
+    // committed; returns whether to go on with the native code after it,
+    // which takes up to remaining_cycles
+    static bool jit_interpret(Basic_CPU* cpu, uint32_t remaining_cycles)
+    {
+        // On the page of the block (see jit_compile())
+        const uint8_t* src = cpu->shared_bus.cpu_page_read[cpu->PC >> 8];
+        unsigned int page_addr = cpu->PC % 0x100;
+        uint8_t opcode = src[page_addr];
+        unsigned int size = 1 + operand_size(opcode_info[opcode].addr_mode);
+
+        uint16_t operand = 0;
+        if(size > 1) operand |= src[page_addr + 1];
+        if(size > 2) operand |= (src[page_addr + 2] << 8);
+
+        bool is_interrupted = (cpu->*exec_for(opcode))(operand);
+        return (!is_interrupted &&
+                (cpu->shared_bus.cpu_map_generation ==
+                 cpu->block_map_generation) &&
+                cpu->is_jit_quiet(remaining_cycles));
+    }
+
+    // In compiled code, rbx points to this CPU, rbp holds the cycles of the
+    // native code run since the last commit, and r15 the index (within the
+    // block) of the first instruction not yet counted in instr_count;
+    // eax/ecx/edx/esi/edi and r8d/r9d are scratch registers
+
+    Asm::Mem jit_member(const void* member)
+    {
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(this);
+        return Asm::mem(Asm::RBX, static_cast<const uint8_t*>(member) - base);
+    }
+
+    Asm::Mem jit_ram(uint16_t offset, Asm::Reg index = Asm::RSP)
+    {
+        Asm::Mem ram_mem = jit_member(ram + offset);
+        ram_mem.index = index;
+        return ram_mem;
+    }
+
+    // Commits the native code's cycles, and its instructions before index k
+    void jit_emit_commit(Asm& x, size_t k)
+    {
+        static_assert(ppu_ticks_per_cpu == 3, "PPU cycles are 3 * rbp");
+
+        x.mov(Asm::RAX, uint32_t(k));
+        x.alu(Asm::SUB, Asm::RAX, Asm::R15);
+        x.alu(Asm::ADD, jit_member(&instr_count), Asm::RAX, true);
+        x.alu(Asm::ADD, jit_member(&cycle_count), Asm::RBP, true);
+        x.lea(Asm::RAX, Asm::mem(Asm::RBP, Asm::RBP, 0, 1));
+        x.alu(Asm::ADD, jit_member(&ppu_cycles_pending), Asm::RAX);
+        x.lea(Asm::RAX, Asm::mem(Asm::RBP, Asm::RBP, 0));
+        x.alu(Asm::ADD, jit_member(&apu_phases_pending), Asm::RAX);
+    }
+
+    // Runs the instruction of index k at addr through jit_interpret(),
+    // leaving the block unless it says otherwise
+    void jit_emit_interpret(Asm& x, size_t k, uint16_t addr,
+                            uint32_t remaining_cycles, Asm::Label exit)
+    {
+        jit_emit_commit(x, k);
+        x.store16(jit_member(&PC), addr);
+
+        x.mov(Asm::RDI, Asm::RBX, true);
+        x.mov(Asm::RSI, remaining_cycles);
+        x.call(&Basic_CPU::jit_interpret);
+
+        x.alu(Asm::XOR, Asm::RBP, Asm::RBP);
+        x.mov(Asm::R15, uint32_t(k + 1));
+        x.test8(Asm::RAX, Asm::RAX);
+        x.jcc(Asm::ZERO, exit);
+    }
+
+    // Loads the entry of a page map table for the page in eax into dst,
+    // leaving for slow if there is none
+    void jit_emit_page(Asm& x, Asm::Reg dst, const void* table,
+                       Asm::Label slow)
+    {
+        x.mov64(dst, reinterpret_cast<uintptr_t>(table));
+        x.mov64(dst, Asm::mem(dst, Asm::RAX, 0, 3));
+        x.test64(dst, dst);
+        x.jcc(Asm::ZERO, slow);
+    }
+
+    // Where a read/write/modify instruction's data is read from and written
+    // to
+    struct JIT_Operand
+    {
+        Asm::Mem read;
+        Asm::Mem write;
+    };
+
+    // Emits the calculation of the effective address, leaving for slow if
+    // any access (dummy reads included, whether taken or not) may fall outside
+    // the page map, and adds the cycle of a page crossing to rbp
+    JIT_Operand jit_emit_operand(Asm& x, AddrMode am, uint16_t operand,
+                                 JIT_Access access, Asm::Label slow)
+    {
+        bool is_read = (access != JIT_Access::WRITE);
+        bool is_write = (access != JIT_Access::READ);
+        bool may_cross = (access == JIT_Access::READ);
+        JIT_Operand paged = { Asm::mem(Asm::RDX, Asm::RCX, 0),
+                              Asm::mem(Asm::RSI, Asm::RCX, 0) };
+
+        // From the address in ecx: page map entries into rdx/rsi, the page
+        // into eax and the low byte into ecx
+        auto emit_pages = [&]()
+        {
+            x.mov(Asm::RAX, Asm::RCX);
+            x.shr(Asm::RAX, 8);
+            if(is_read)
+                jit_emit_page(x, Asm::RDX, shared_bus.cpu_page_read, slow);
+            if(is_write)
+                jit_emit_page(x, Asm::RSI, shared_bus.cpu_page_write, slow);
+            x.movzx8(Asm::RCX, Asm::RCX);
+        };
+
+        // Whether the page in eax differs from that of the base address
+        auto emit_crossing = [&](Asm::Reg base_page)
+        {
+            x.alu(Asm::CMP, Asm::RAX, base_page);
+            x.setcc(Asm::NOT_EQUAL, Asm::RAX);
+            x.movzx8(Asm::RAX, Asm::RAX);
+            x.alu(Asm::ADD, Asm::RBP, Asm::RAX, true);
+        };
+
+        switch(am)
+        {
+            case(Acc):
+                return { jit_member(&A), jit_member(&A) };
+
+            case(ZP):
+                return { jit_ram(operand), jit_ram(operand) };
+
+            case(ZPX): case(ZPY):
+                // Wraps around within the zero page
+                x.movzx8(Asm::RCX, jit_member((am == ZPX) ? &X : &Y));
+                x.alu8(Asm::ADD, Asm::RCX, uint8_t(operand));
+                return { jit_ram(0, Asm::RCX), jit_ram(0, Asm::RCX) };
+
+            case(Ab):
+                if(operand < 0x2000)
+                {
+                    uint16_t offset = operand % 0x800;
+                    return { jit_ram(offset), jit_ram(offset) };
+                }
+                x.mov(Asm::RCX, operand);
+                emit_pages();
+                return paged;
+
+            case(AbX): case(AbXS): case(AbY): case(AbYS):
+            {
+                bool is_x = ((am == AbX) || (am == AbXS));
+                bool is_page_crossing_timed = (may_cross &&
+                                               ((am == AbX) || (am == AbY)));
+                uint8_t base_page = operand >> 8;
+                x.movzx8(Asm::RCX, jit_member(is_x ? &X : &Y));
+                x.alu(Asm::ADD, Asm::RCX, operand);
+                x.mov(Asm::RDI, base_page);
+
+                // Work RAM on both pages (see jit_count_cycles())
+                if(base_page < 0x20)
+                {
+                    if(is_page_crossing_timed)
+                    {
+                        x.mov(Asm::RAX, Asm::RCX);
+                        x.shr(Asm::RAX, 8);
+                        emit_crossing(Asm::RDI);
+                    }
+                    x.alu(Asm::AND, Asm::RCX, 0x7FF);
+                    return { jit_ram(0, Asm::RCX), jit_ram(0, Asm::RCX) };
+                }
+
+                // Dummy read on the page of the base address
+                x.mov(Asm::RAX, Asm::RDI);
+                jit_emit_page(x, Asm::RDX, shared_bus.cpu_page_read, slow);
+
+                x.alu(Asm::AND, Asm::RCX, 0xFFFF);
+                emit_pages();
+                if(is_page_crossing_timed) emit_crossing(Asm::RDI);
+                return paged;
+            }
+
+            case(InX):
+                x.movzx8(Asm::RAX, jit_member(&X));
+                x.alu8(Asm::ADD, Asm::RAX, uint8_t(operand));
+                x.movzx8(Asm::RCX, jit_ram(0, Asm::RAX));
+                x.alu8(Asm::ADD, Asm::RAX, 1);
+                x.movzx8(Asm::RAX, jit_ram(0, Asm::RAX));
+                x.shl(Asm::RAX, 8);
+                x.alu(Asm::OR, Asm::RCX, Asm::RAX);
+                emit_pages();
+                return paged;
+
+            case(InY): case(InYS):
+                x.movzx8(Asm::RCX, jit_ram(operand));
+                x.movzx8(Asm::RAX, jit_ram((operand + 1) % 0x100));
+                x.mov(Asm::RDI, Asm::RAX);
+
+                // Dummy read on the page of the base address
+                jit_emit_page(x, Asm::RDX, shared_bus.cpu_page_read, slow);
+
+                x.shl(Asm::RAX, 8);
+                x.alu(Asm::OR, Asm::RCX, Asm::RAX);
+                x.movzx8(Asm::RAX, jit_member(&Y));
+                x.alu(Asm::ADD, Asm::RCX, Asm::RAX);
+                x.alu(Asm::AND, Asm::RCX, 0xFFFF);
+                emit_pages();
+                if(may_cross && (am == InY)) emit_crossing(Asm::RDI);
+                return paged;
+
+            default:
+                return {};
+        }
+    }
+
+    // Emits the native code of an instruction (see jit_count_cycles()),
+    // leaving for slow before it has any effect if it must be interpreted
+    // after all. Control flow instructions end the block of instr_num
+    // instructions, leaving it for exit
+    void jit_emit_native(Asm& x, const JIT_Instr& instr, size_t instr_num,
+                         Asm::Label slow, Asm::Label exit)
+    {
+        const Opcode_Info& info = opcode_info[instr.opcode];
+        Instr i = info.instr;
+        AddrMode am = info.addr_mode;
+        uint16_t operand = instr.operand;
+
+        auto add_cycles = [&](unsigned int cycles)
+        {
+            x.alu(Asm::ADD, Asm::RBP, int32_t(cycles), true);
+        };
+
+        // From a byte zero-extended in r
+        auto assign_zn_flags = [&](Asm::Reg r)
+        {
+            x.store16(jit_member(&flag_nz), r);
+        };
+
+        auto exit_to = [&](uint16_t new_PC)
+        {
+            jit_emit_commit(x, instr_num);
+            x.store16(jit_member(&PC), new_PC);
+            x.jmp(exit);
+        };
+
+        auto reg = [&]() -> uint8_t*
+        {
+            switch(i)
+            {
+                case(LDX): case(STX): case(CPX): return &X;
+                case(LDY): case(STY): case(CPY): return &Y;
+                default:                         return &A;
+            }
+        };
+
+        JIT_Access access = jit_access(i);
+        if(access != JIT_Access::NONE)
+        {
+            JIT_Operand data = {};
+            if(am != Imm) data = jit_emit_operand(x, am, operand, access, slow);
+            add_cycles(instr.cycles);
+
+            if(am == Imm)
+                x.mov(Asm::RAX, uint32_t(operand));
+            else if(access != JIT_Access::WRITE)
+                x.movzx8(Asm::RAX, data.read);
+
+            switch(i)
+            {
+                case(LDA): case(LDX): case(LDY):
+                    x.store8(jit_member(reg()), Asm::RAX);
+                    assign_zn_flags(Asm::RAX);
+                    break;
+
+                case(STA): case(STX): case(STY):
+                    x.movzx8(Asm::RAX, jit_member(reg()));
+                    x.store8(data.write, Asm::RAX);
+                    break;
+
+                case(AND): case(ORA): case(EOR):
+                    x.movzx8(Asm::R8, jit_member(&A));
+                    x.alu((i == AND) ? Asm::AND :
+                          (i == ORA) ? Asm::OR  : Asm::XOR, Asm::R8, Asm::RAX);
+                    x.store8(jit_member(&A), Asm::R8);
+                    assign_zn_flags(Asm::R8);
+                    break;
+
+                case(SBC):
+                    x.alu(Asm::XOR, Asm::RAX, 0xFF);
+                    [[fallthrough]];
+                case(ADC):
+                    x.movzx8(Asm::R8, jit_member(&A));
+                    x.movzx8(Asm::R9, jit_member(&flag_c));
+                    x.alu(Asm::ADD, Asm::R9, Asm::R8);
+                    x.alu(Asm::ADD, Asm::R9, Asm::RAX);
+                    x.alu(Asm::CMP, Asm::R9, 0xFF);
+                    x.setcc(Asm::ABOVE, jit_member(&flag_c));
+                    x.alu(Asm::XOR, Asm::R8, Asm::R9);
+                    x.alu(Asm::XOR, Asm::RAX, Asm::R9);
+                    x.alu(Asm::AND, Asm::RAX, Asm::R8);
+                    x.store8(jit_member(&flag_v), Asm::RAX);
+                    x.movzx8(Asm::R9, Asm::R9);
+                    x.store8(jit_member(&A), Asm::R9);
+                    assign_zn_flags(Asm::R9);
+                    break;
+
+                case(CMP): case(CPX): case(CPY):
+                    x.movzx8(Asm::R8, jit_member(reg()));
+                    x.alu(Asm::CMP, Asm::R8, Asm::RAX);
+                    x.setcc(Asm::ABOVE_EQUAL, jit_member(&flag_c));
+                    x.alu(Asm::SUB, Asm::R8, Asm::RAX);
+                    x.movzx8(Asm::R8, Asm::R8);
+                    assign_zn_flags(Asm::R8);
+                    break;
+
+                case(BIT):
+                    x.movzx8(Asm::R8, jit_member(&A));
+                    x.alu(Asm::AND, Asm::R8, Asm::RAX);
+                    x.mov(Asm::R9, Asm::RAX);
+                    x.alu(Asm::AND, Asm::R9, 0x80);
+                    x.alu(Asm::ADD, Asm::R9, Asm::R9);
+                    x.alu(Asm::OR, Asm::R8, Asm::R9);
+                    x.store16(jit_member(&flag_nz), Asm::R8);
+                    x.alu(Asm::ADD, Asm::RAX, Asm::RAX);
+                    x.store8(jit_member(&flag_v), Asm::RAX);
+                    break;
+
+                default:
+                    // Modify
+                    switch(i)
+                    {
+                        case(INC):
+                            x.alu(Asm::ADD, Asm::RAX, 1);
+                            break;
+                        case(DEC):
+                            x.alu(Asm::SUB, Asm::RAX, 1);
+                            break;
+                        case(ASL): case(ROL):
+                            x.movzx8(Asm::R9, jit_member(&flag_c));
+                            x.mov(Asm::R8, Asm::RAX);
+                            x.shr(Asm::R8, 7);
+                            x.store8(jit_member(&flag_c), Asm::R8);
+                            x.alu(Asm::ADD, Asm::RAX, Asm::RAX);
+                            if(i == ROL) x.alu(Asm::OR, Asm::RAX, Asm::R9);
+                            break;
+                        default:
+                            // LSR, ROR
+                            x.movzx8(Asm::R9, jit_member(&flag_c));
+                            x.mov(Asm::R8, Asm::RAX);
+                            x.alu(Asm::AND, Asm::R8, 1);
+                            x.store8(jit_member(&flag_c), Asm::R8);
+                            x.shr(Asm::RAX, 1);
+                            x.shl(Asm::R9, 7);
+                            if(i == ROR) x.alu(Asm::OR, Asm::RAX, Asm::R9);
+                            break;
+                    }
+                    x.movzx8(Asm::RAX, Asm::RAX);
+                    x.store8(data.write, Asm::RAX);
+                    assign_zn_flags(Asm::RAX);
+                    break;
+            }
+            return;
+        }
+
+        // Transfers, and increments/decrements (by delta) of registers
+        auto emit_move = [&](const uint8_t* src, uint8_t* dst, int delta,
+                             bool sets_zn_flags)
+        {
+            x.movzx8(Asm::RAX, jit_member(src));
+            if(delta)
+            {
+                x.alu(Asm::ADD, Asm::RAX, delta);
+                x.movzx8(Asm::RAX, Asm::RAX);
+            }
+            x.store8(jit_member(dst), Asm::RAX);
+            if(sets_zn_flags) assign_zn_flags(Asm::RAX);
+        };
+
+        if(!is_control_flow(i))
+            add_cycles(instr.cycles);
+
+        switch(i)
+        {
+            case(TAX): emit_move(&A, &X,  0, true);  break;
+            case(TAY): emit_move(&A, &Y,  0, true);  break;
+            case(TXA): emit_move(&X, &A,  0, true);  break;
+            case(TYA): emit_move(&Y, &A,  0, true);  break;
+            case(TSX): emit_move(&SP, &X, 0, true);  break;
+            case(TXS): emit_move(&X, &SP, 0, false); break;
+            case(INX): emit_move(&X, &X,  1, true);  break;
+            case(INY): emit_move(&Y, &Y,  1, true);  break;
+            case(DEX): emit_move(&X, &X, -1, true);  break;
+            case(DEY): emit_move(&Y, &Y, -1, true);  break;
+
+            case(NOP): break;
+
+            case(CLC): x.store8(jit_member(&flag_c), uint8_t(0)); break;
+            case(SEC): x.store8(jit_member(&flag_c), uint8_t(1)); break;
+            case(CLV): x.store8(jit_member(&flag_v), uint8_t(0)); break;
+            case(CLD):
+                x.alu8(Asm::AND, jit_member(&PS), uint8_t(~PS_Flags::DECIMAL));
+                break;
+            case(SED):
+                x.alu8(Asm::OR, jit_member(&PS), PS_Flags::DECIMAL);
+                break;
+
+            case(PHA):
+                x.movzx8(Asm::RAX, jit_member(&SP));
+                x.movzx8(Asm::R8, jit_member(&A));
+                x.store8(jit_ram(0x100, Asm::RAX), Asm::R8);
+                x.alu(Asm::SUB, Asm::RAX, 1);
+                x.store8(jit_member(&SP), Asm::RAX);
+                break;
+
+            case(PLA):
+                x.movzx8(Asm::RAX, jit_member(&SP));
+                x.alu8(Asm::ADD, Asm::RAX, 1);
+                x.movzx8(Asm::R8, jit_ram(0x100, Asm::RAX));
+                x.store8(jit_member(&SP), Asm::RAX);
+                x.store8(jit_member(&A), Asm::R8);
+                assign_zn_flags(Asm::R8);
+                break;
+
+            case(JSR):
+            {
+                // Pushes the address of its last byte
+                uint16_t return_addr = instr.addr + 2;
+                add_cycles(instr.cycles);
+                x.movzx8(Asm::RAX, jit_member(&SP));
+                x.store8(jit_ram(0x100, Asm::RAX), uint8_t(return_addr >> 8));
+                x.alu8(Asm::ADD, Asm::RAX, 0xFF);
+                x.store8(jit_ram(0x100, Asm::RAX), uint8_t(return_addr));
+                x.alu8(Asm::ADD, Asm::RAX, 0xFF);
+                x.store8(jit_member(&SP), Asm::RAX);
+                exit_to(operand);
+                break;
+            }
+
+            case(RTS):
+                add_cycles(instr.cycles);
+                x.movzx8(Asm::RAX, jit_member(&SP));
+                x.alu8(Asm::ADD, Asm::RAX, 1);
+                x.movzx8(Asm::RCX, jit_ram(0x100, Asm::RAX));
+                x.alu8(Asm::ADD, Asm::RAX, 1);
+                x.movzx8(Asm::R8, jit_ram(0x100, Asm::RAX));
+                x.store8(jit_member(&SP), Asm::RAX);
+                x.shl(Asm::R8, 8);
+                x.alu(Asm::OR, Asm::RCX, Asm::R8);
+                x.alu(Asm::ADD, Asm::RCX, 1);
+
+                jit_emit_commit(x, instr_num);
+                x.store16(jit_member(&PC), Asm::RCX);
+                x.jmp(exit);
+                break;
+
+            case(JMP):
+                // JMP * (see skip_idle_loop())
+                add_cycles(instr.cycles);
+                x.store8(jit_member(&is_idle_loop_candidate),
+                         uint8_t(operand == instr.addr));
+                x.store16(jit_member(&idle_loop_jump_addr), instr.addr);
+                exit_to(operand);
+                break;
+
+            default:
+            {
+                // Branches, taken on cond
+                Asm::Cond cond = Asm::ZERO;
+                switch(i)
+                {
+                    case(BPL): case(BMI):
+                        x.test16(jit_member(&flag_nz), 0x180);
+                        cond = ((i == BPL) ? Asm::ZERO : Asm::NOT_ZERO);
+                        break;
+                    case(BVC): case(BVS):
+                        x.test8(jit_member(&flag_v), 0x80);
+                        cond = ((i == BVC) ? Asm::ZERO : Asm::NOT_ZERO);
+                        break;
+                    case(BCC): case(BCS):
+                        x.test8(jit_member(&flag_c), 0xFF);
+                        cond = ((i == BCC) ? Asm::ZERO : Asm::NOT_ZERO);
+                        break;
+                    default:
+                        // BNE, BEQ (on the low byte of flag_nz)
+                        x.test8(jit_member(&flag_nz), 0xFF);
+                        cond = ((i == BNE) ? Asm::NOT_ZERO : Asm::ZERO);
+                        break;
+                }
+
+                Asm::Label not_taken = x.new_label();
+                x.jcc(Asm::Cond(cond ^ 1), not_taken);
+
+                // Back to a load just before the branch (see skip_idle_loop())
+                int displacement = ((operand + 0x80) % 0x100) - 0x80;
+                uint16_t next_PC = instr.addr + 2;
+                add_cycles(instr.max_cycles);
+                x.store8(jit_member(&is_idle_loop_candidate),
+                         uint8_t((displacement == -4) || (displacement == -5)));
+                x.store16(jit_member(&idle_loop_jump_addr), instr.addr);
+                exit_to(next_PC + displacement);
+
+                x.bind(not_taken);
+                add_cycles(instr.cycles);
+                exit_to(next_PC);
+                break;
+            }
+        }
+    }
+
+    // Precondition: src is the read-only memory mapped at the page of addr
+    Asm::Block jit_compile(JIT_Block& block, uint16_t addr,
+                           const uint8_t* src)
+    {
+        vector<JIT_Instr> instrs;
+        bool has_native_code = false;
+        while(true)
+        {
+            uint8_t page_addr = addr % 0x100;
+            uint8_t opcode = src[page_addr];
+            const Opcode_Info& info = opcode_info[opcode];
+            unsigned int size = 1 + operand_size(info.addr_mode);
+
+            // Bytes on the next page may belong to a different bank
+            if(page_addr + size > 0x100) break;
+
+            JIT_Instr instr = { addr, opcode, 0, 0, 0 };
+            if(size > 1) instr.operand |= src[page_addr + 1];
+            if(size > 2) instr.operand |= (src[page_addr + 2] << 8);
+            jit_count_cycles(instr);
+            has_native_code = has_native_code || (instr.max_cycles > 0);
+            instrs.push_back(instr);
+
+            if(is_control_flow(info.instr) || (page_addr + size == 0x100))
+                break;
+            addr += size;
+        }
+
+        // Nothing to gain over the interpreter
+        if(!has_native_code)
+            return nullptr;
+
+        size_t instr_num = instrs.size();
+        if(!jit_code.has_room(instr_num))
+        {
+            // Start over; blocks will be recompiled as they become hot again
+            // (invalidates block)
+            jit_code.reset();
+            jit_cache.clear();
+            return nullptr;
+        }
+
+        // Cycles of the native code from each instruction on, up to the next
+        // one to be interpreted
+        vector<uint32_t> native_cycles(instr_num + 1, 0);
+        for(size_t k = instr_num; k-- > 0; )
+        {
+            if(instrs[k].max_cycles)
+                native_cycles[k] = instrs[k].max_cycles + native_cycles[k + 1];
+        }
+
+        Asm& x = jit_code;
+        if(!x.begin_block(instr_num))
+            return nullptr;
+
+        x.push(Asm::RBX);
+        x.push(Asm::RBP);
+        x.push(Asm::R15);
+        x.mov(Asm::RBX, Asm::RDI, true);
+        x.alu(Asm::XOR, Asm::RBP, Asm::RBP);
+        x.alu(Asm::XOR, Asm::R15, Asm::R15);
+
+        Asm::Label exit = x.new_label();
+        vector<size_t> slow_instrs;
+        vector<Asm::Label> slow_paths, resume_points;
+        for(size_t k = 0; k < instr_num; ++k)
+        {
+            const JIT_Instr& instr = instrs[k];
+            if(!instr.max_cycles)
+            {
+                jit_emit_interpret(x, k, instr.addr, native_cycles[k + 1],
+                                   exit);
+                continue;
+            }
+
+            Asm::Label slow = x.new_label();
+            jit_emit_native(x, instr, instr_num, slow, exit);
+            if(x.is_referenced(slow))
+            {
+                Asm::Label resume = x.new_label();
+                x.bind(resume);
+                slow_instrs.push_back(k);
+                slow_paths.push_back(slow);
+                resume_points.push_back(resume);
+            }
+        }
+
+        // Ending with the last instruction on the page
+        const JIT_Instr& last = instrs.back();
+        if(last.max_cycles && !is_control_flow(opcode_info[last.opcode].instr))
+        {
+            jit_emit_commit(x, instr_num);
+            unsigned int size =
+                1 + operand_size(opcode_info[last.opcode].addr_mode);
+            x.store16(jit_member(&PC), uint16_t(last.addr + size));
+        }
+        x.jmp(exit);
+
+        for(size_t k = 0; k < slow_instrs.size(); ++k)
+        {
+            const JIT_Instr& instr = instrs[slow_instrs[k]];
+            x.bind(slow_paths[k]);
+            jit_emit_interpret(x, slow_instrs[k], instr.addr,
+                               native_cycles[slow_instrs[k] + 1], exit);
+            x.jmp(resume_points[k]);
+        }
+
+        x.bind(exit);
+        x.pop(Asm::R15);
+        x.pop(Asm::RBP);
+        x.pop(Asm::RBX);
+        x.ret();
+
+        block.max_cycles = native_cycles[0];
+        block.code = x.end_block();
+        return block.code;
+    }
+
+    // Returns whether a compiled block (of at least one instruction) was run
+    bool jit_execute()
+    {
+        const uint8_t* src = shared_bus.cpu_page_read[PC >> 8];
+        bool is_read_only = (src && !shared_bus.cpu_page_write[PC >> 8]);
+        if(!is_read_only)
+            return false;
+
+        JIT_Block* block = jit_cache.find(PC, src);
+        if(!block)
+        {
+            block = &jit_cache.insert(PC, src);
+            *block = JIT_Block();
+        }
+
+        Asm::Block code = block->code;
+        if(!code)
+        {
+            // Blocks which cannot be compiled are only attempted once
+            if(++(block->hit_count) != jit_hot_threshold)
+                return false;
+
+            code = jit_compile(*block, PC, src);
+            if(!code)
+                return false;
+        }
+
+        if(!is_jit_quiet(block->max_cycles))
+            return false;
+
+        block_map_generation = shared_bus.cpu_map_generation;
+        code(this);
+
+        // As end_instruction() would after a branch/JMP in native code
+        if(is_idle_loop_candidate)
+        {
+            is_idle_loop_candidate = false;
+            skip_idle_loop();
+        }
+        return true;
+    }
+#endif
+
+#ifdef NOS_CPU_AOT
+    // Blocks of statically recompiled code (see aot/), keyed by the memory
+    // they were verified against on attachment
+    using Compiled_Func = void(*)(Basic_CPU&);
+    Decode_Cache<Compiled_Func> aot_cache;
+
+    // Returns whether a compiled block was run
+    bool aot_execute()
+    {
+        const uint8_t* src = shared_bus.cpu_page_read[PC >> 8];
+        bool is_read_only = (src && !shared_bus.cpu_page_write[PC >> 8]);
+        if(!is_read_only)
+            return false;
+
+        const Compiled_Func* func = aot_cache.find(PC, src);
+        if(!func)
+            return false;
+
+        block_map_generation = shared_bus.cpu_map_generation;
+        (*func)(*this);
+        return true;
+    }
+#endif
+
+#ifdef NOS_CPU_COMPILED_CODE
+    bool is_compiled_code_enabled = true;
+#endif
+    // Page map generation on entry to the current compiled block
+    uint32_t block_map_generation = 0;
+
 
   public:
     
-    CPU(Shared_Bus& shared_bus, Cartridge& cart, PPU& ppu, APU& apu, 
-            Controller& port_one, Controller& port_two)
+    Basic_CPU(Shared_Bus& shared_bus, Cart& cart, Basic_PPU<Cart>& ppu, 
+              APU& apu, Controller& port_one, Controller& port_two)
         : shared_bus(shared_bus), cart(cart), ppu(ppu), apu(apu), 
           port_one(port_one), port_two(port_two)
     {
+        // Work RAM is mirrored every 0x800 bytes up to $1FFF
+        for(unsigned int mirror = 0; mirror < 0x2000; mirror += 0x800)
+            shared_bus.map_cpu_pages(mirror >> 8, 0x8, ram, ram);
+        cart.cpu_map_pages(shared_bus);
+
         reset_state(true);
     }
 
     uint64_t get_cycle_count() { return cycle_count; }
-    
+    uint64_t get_instruction_count() { return instr_count; }
+
+    // Idle loop skipping (see skip_idle_loop()) is on by default; turning it
+    // off leaves every iteration to be executed, e.g. to check it against
+    void set_idle_loop_skipping(bool is_enabled)
+    {
+        is_idle_loop_skipping_enabled = is_enabled;
+    }
+
+    // Architectural state, for debugging/comparing backends
+    struct State
+    {
+        uint8_t A, X, Y, PS, SP;
+        uint16_t PC;
+        uint64_t cycle_count;
+        uint64_t instr_count;
+
+        bool operator==(const State& other) const
+        {
+            return (A == other.A) && (X == other.X) && (Y == other.Y) &&
+                   (PS == other.PS) && (SP == other.SP) && (PC == other.PC) &&
+                   (cycle_count == other.cycle_count) &&
+                   (instr_count == other.instr_count);
+        }
+        bool operator!=(const State& other) const { return !(*this == other); }
+    };
+
+    State get_state() 
+    { 
+        return { A, X, Y, get_PS(), SP, PC, cycle_count, instr_count };
+    }
+
+    // Sets the registers (leaving the counts as they are), e.g. to run an
+    // instruction on given inputs
+    void set_state(const State& state)
+    {
+        A = state.A;
+        X = state.X;
+        Y = state.Y;
+        set_PS(state.PS);
+        SP = state.SP;
+        PC = state.PC;
+    }
+
+#ifdef NOS_CPU_COMPILED_CODE
+    // Disabling compiled code leaves only the interpreter
+    void set_compiled_code_enabled(bool is_enabled) 
+    { 
+        is_compiled_code_enabled = is_enabled; 
+    }
+
+    void set_bus_traced(bool is_traced) { is_bus_traced = is_traced; }
+    uint64_t get_bus_trace() { return bus_trace; }
+#endif
+
+    // Executes one instruction from its pre-decoded bytes (rather than
+    // fetching them from memory), for compiled code; returns whether to
+    // continue with the next instruction of the block, i.e. neither was an
+    // interrupt serviced, nor was the page map changed (bank switch)
+    // Precondition: decoded is the instruction at PC
+    template<Instr i, AddrMode am>
+    bool exec_decoded(const Decoded_Instr* decoded)
+    {
+        uint16_t operand = (decoded->bytes[2] << 8) | decoded->bytes[1];
+
+        bool is_interrupted = exec_prefetched<i,am>(operand);
+        return !is_interrupted && 
+            (shared_bus.cpu_map_generation == block_map_generation);
+    }
+
+#ifdef NOS_CPU_AOT
+    // Statically recompiled basic block, along with the instructions it was
+    // compiled from
+    struct Compiled_Block
+    {
+        uint16_t addr;
+        void (*func)(Basic_CPU&);
+        const Decoded_Instr* instrs;
+        size_t instr_num;
+    };
+
+    // Blocks whose instructions do not match the memory currently mapped at
+    // their address (or which are not in PRG-ROM) are ignored
+    void attach_compiled_code(const Compiled_Block* blocks, size_t block_num)
+    {
+        for(size_t b = 0; b < block_num; ++b)
+        {
+            const Compiled_Block& block = blocks[b];
+            const uint8_t* src = shared_bus.cpu_page_read[block.addr >> 8];
+            bool is_read_only = 
+                (src && !shared_bus.cpu_page_write[block.addr >> 8]);
+            if(!is_read_only)
+                continue;
+
+            unsigned int page_addr = block.addr % 0x100;
+            bool is_match = true;
+            for(size_t k = 0; (k < block.instr_num) && is_match; ++k)
+            {
+                const uint8_t* bytes = block.instrs[k].bytes;
+                unsigned int size = 
+                    1 + operand_size(opcode_info[bytes[0]].addr_mode);
+
+                is_match = ((page_addr + size) <= 0x100) &&
+                           (memcmp(src + page_addr, bytes, size) == 0);
+                page_addr += size;
+            }
+
+            if(is_match)
+                aot_cache.insert(block.addr, src) = block.func;
+        }
+    }
+#endif
+
+    // Executes at least one instruction (a whole block if compiled code or
+    // the decode cache is used)
     void execute_instruction()
     {
-        using C = CPU;
+#ifdef NOS_CPU_COMPILED_CODE
+        if(is_compiled_code_enabled)
+        {
+#ifdef NOS_CPU_JIT
+            if(jit_execute()) return;
+#endif
+#ifdef NOS_CPU_AOT
+            if(aot_execute()) return;
+#endif
+        }
+#endif
+#ifdef NOS_CPU_DECODE_CACHE
+        if(execute_cached_block()) return;
+#endif
+        uint8_t opcode = fetch();
+
+#ifdef NOS_CPU_SWITCH_DISPATCH
+        // Single dispatch function; every op<>() is expanded inline into one
+        // switch, avoiding an indirect member function call per instruction
+        switch(opcode)
+        {
+#define NOS_OPCODE_CASE(code, i, am) case(code): op<i,am>(); break;
+            NOS_OPCODE_MAP(NOS_OPCODE_CASE)
+#undef NOS_OPCODE_CASE
+        }
+#else
+        using C = Basic_CPU;
         using Func = void(C::*)();
 
         static constexpr Func dispatch_table[0x100] = 
         {
-          //+0x00            +0x01            +0x02            +0x03
-/*0x00*/    &C::op<BRK,Imp>, &C::op<ORA,InX>, &C::op<STP,Imp>, &C::op<SLO,InX>, 
-/*0x04*/    &C::op<NOP,ZP>,  &C::op<ORA,ZP>,  &C::op<ASL,ZP>,  &C::op<SLO,ZP>,  
-/*0x08*/    &C::op<PHP,Imp>, &C::op<ORA,Imm>, &C::op<ASL,Acc>, &C::op<ANC,Imm>, 
-/*0x0C*/    &C::op<NOP,Ab>,  &C::op<ORA,Ab>,  &C::op<ASL,Ab>,  &C::op<SLO,Ab>,  
-/*0x10*/    &C::op<BPL,Imm>, &C::op<ORA,InY>, &C::op<STP,Imp>, &C::op<SLO,InYS>, 
-/*0x14*/    &C::op<NOP,ZPX>, &C::op<ORA,ZPX>, &C::op<ASL,ZPX>, &C::op<SLO,ZPX>, 
-/*0x18*/    &C::op<CLC,Imp>, &C::op<ORA,AbY>, &C::op<NOP,Imp>, &C::op<SLO,AbYS>, 
-/*0x1C*/    &C::op<NOP,AbX>, &C::op<ORA,AbX>, &C::op<ASL,AbXS>,&C::op<SLO,AbXS>, 
-/*0x20*/    &C::op<JSR,Ab>,  &C::op<AND,InX>, &C::op<STP,Imp>, &C::op<RLA,InX>, 
-/*0x24*/    &C::op<BIT,ZP>,  &C::op<AND,ZP>,  &C::op<ROL,ZP>,  &C::op<RLA,ZP>,  
-/*0x28*/    &C::op<PLP,Imp>, &C::op<AND,Imm>, &C::op<ROL,Acc>, &C::op<ANC,Imm>, 
-/*0x2C*/    &C::op<BIT,Ab>,  &C::op<AND,Ab>,  &C::op<ROL,Ab>,  &C::op<RLA,Ab>,  
-/*0x30*/    &C::op<BMI,Imm>, &C::op<AND,InY>, &C::op<STP,Imp>, &C::op<RLA,InYS>, 
-/*0x34*/    &C::op<NOP,ZPX>, &C::op<AND,ZPX>, &C::op<ROL,ZPX>, &C::op<RLA,ZPX>, 
-/*0x38*/    &C::op<SEC,Imp>, &C::op<AND,AbY>, &C::op<NOP,Imp>, &C::op<RLA,AbYS>, 
-/*0x3C*/    &C::op<NOP,AbX>, &C::op<AND,AbX>, &C::op<ROL,AbXS>,&C::op<RLA,AbXS>, 
-/*0x40*/    &C::op<RTI,Imp>, &C::op<EOR,InX>, &C::op<STP,Imp>, &C::op<SRE,InX>, 
-/*0x44*/    &C::op<NOP,ZP>,  &C::op<EOR,ZP>,  &C::op<LSR,ZP>,  &C::op<SRE,ZP>,  
-/*0x48*/    &C::op<PHA,Imp>, &C::op<EOR,Imm>, &C::op<LSR,Acc>, &C::op<ALR,Imm>, 
-/*0x4C*/    &C::op<JMP,Ab>,  &C::op<EOR,Ab>,  &C::op<LSR,Ab>,  &C::op<SRE,Ab>,  
-/*0x50*/    &C::op<BVC,Imm>, &C::op<EOR,InY>, &C::op<STP,Imp>, &C::op<SRE,InYS>, 
-/*0x54*/    &C::op<NOP,ZPX>, &C::op<EOR,ZPX>, &C::op<LSR,ZPX>, &C::op<SRE,ZPX>, 
-/*0x58*/    &C::op<CLI,Imp>, &C::op<EOR,AbY>, &C::op<NOP,Imp>, &C::op<SRE,AbYS>, 
-/*0x5C*/    &C::op<NOP,AbX>, &C::op<EOR,AbX>, &C::op<LSR,AbXS>,&C::op<SRE,AbXS>, 
-/*0x60*/    &C::op<RTS,Imp>, &C::op<ADC,InX>, &C::op<STP,Imp>, &C::op<RRA,InX>, 
-/*0x64*/    &C::op<NOP,ZP>,  &C::op<ADC,ZP>,  &C::op<ROR,ZP>,  &C::op<RRA,ZP>,  
-/*0x68*/    &C::op<PLA,Imp>, &C::op<ADC,Imm>, &C::op<ROR,Acc>, &C::op<ARR,Imm>, 
-/*0x6C*/    &C::op<JMP,In>,  &C::op<ADC,Ab>,  &C::op<ROR,Ab>,  &C::op<RRA,Ab>,  
-/*0x70*/    &C::op<BVS,Imm>, &C::op<ADC,InY>, &C::op<STP,Imp>, &C::op<RRA,InYS>, 
-/*0x74*/    &C::op<NOP,ZPX>, &C::op<ADC,ZPX>, &C::op<ROR,ZPX>, &C::op<RRA,ZPX>, 
-/*0x78*/    &C::op<SEI,Imp>, &C::op<ADC,AbY>, &C::op<NOP,Imp>, &C::op<RRA,AbYS>, 
-/*0x7C*/    &C::op<NOP,AbX>, &C::op<ADC,AbX>, &C::op<ROR,AbXS>,&C::op<RRA,AbXS>, 
-/*0x80*/    &C::op<NOP,Imm>, &C::op<STA,InX>, &C::op<NOP,Imm>, &C::op<SAX,InX>, 
-/*0x84*/    &C::op<STY,ZP>,  &C::op<STA,ZP>,  &C::op<STX,ZP>,  &C::op<SAX,ZP>,  
-/*0x88*/    &C::op<DEY,Imp>, &C::op<NOP,Imm>, &C::op<TXA,Imp>, &C::op<XAA,Imm>, 
-/*0x8C*/    &C::op<STY,Ab>,  &C::op<STA,Ab>,  &C::op<STX,Ab>,  &C::op<SAX,Ab>,  
-/*0x90*/    &C::op<BCC,Imm>, &C::op<STA,InYS>,&C::op<STP,Imp>, &C::op<AHX,InY>, 
-/*0x94*/    &C::op<STY,ZPX>, &C::op<STA,ZPX>, &C::op<STX,ZPY>, &C::op<SAX,ZPY>, 
-/*0x98*/    &C::op<TYA,Imp>, &C::op<STA,AbYS>,&C::op<TXS,Imp>, &C::op<TAS,AbY>, 
-/*0x9C*/    &C::op<SHY,AbX>, &C::op<STA,AbXS>,&C::op<SHX,AbY>, &C::op<AHX,AbY>, 
-/*0xA0*/    &C::op<LDY,Imm>, &C::op<LDA,InX>, &C::op<LDX,Imm>, &C::op<LAX,InX>, 
-/*0xA4*/    &C::op<LDY,ZP>,  &C::op<LDA,ZP>,  &C::op<LDX,ZP>,  &C::op<LAX,ZP>,  
-/*0xA8*/    &C::op<TAY,Imp>, &C::op<LDA,Imm>, &C::op<TAX,Imp>, &C::op<LAX,Imm>, 
-/*0xAC*/    &C::op<LDY,Ab>,  &C::op<LDA,Ab>,  &C::op<LDX,Ab>,  &C::op<LAX,Ab>,  
-/*0xB0*/    &C::op<BCS,Imm>, &C::op<LDA,InY>, &C::op<STP,Imp>, &C::op<LAX,InY>, 
-/*0xB4*/    &C::op<LDY,ZPX>, &C::op<LDA,ZPX>, &C::op<LDX,ZPY>, &C::op<LAX,ZPY>, 
-/*0xB8*/    &C::op<CLV,Imp>, &C::op<LDA,AbY>, &C::op<TSX,Imp>, &C::op<LAS,AbY>, 
-/*0xBC*/    &C::op<LDY,AbX>, &C::op<LDA,AbX>, &C::op<LDX,AbY>, &C::op<LAX,AbY>, 
-/*0xC0*/    &C::op<CPY,Imm>, &C::op<CMP,InX>, &C::op<NOP,Imm>, &C::op<DCP,InX>, 
-/*0xC4*/    &C::op<CPY,ZP>,  &C::op<CMP,ZP>,  &C::op<DEC,ZP>,  &C::op<DCP,ZP>,  
-/*0xC8*/    &C::op<INY,Imp>, &C::op<CMP,Imm>, &C::op<DEX,Imp>, &C::op<AXS,Imm>, 
-/*0xCC*/    &C::op<CPY,Ab>,  &C::op<CMP,Ab>,  &C::op<DEC,Ab>,  &C::op<DCP,Ab>,  
-/*0xD0*/    &C::op<BNE,Imm>, &C::op<CMP,InY>, &C::op<STP,Imp>, &C::op<DCP,InYS>,
-/*0xD4*/    &C::op<NOP,ZPX>, &C::op<CMP,ZPX>, &C::op<DEC,ZPX>, &C::op<DCP,ZPX>, 
-/*0xD8*/    &C::op<CLD,Imp>, &C::op<CMP,AbY>, &C::op<NOP,Imp>, &C::op<DCP,AbYS>, 
-/*0xDC*/    &C::op<NOP,AbX>, &C::op<CMP,AbX>, &C::op<DEC,AbXS>,&C::op<DCP,AbXS>, 
-/*0xE0*/    &C::op<CPX,Imm>, &C::op<SBC,InX>, &C::op<NOP,Imm>, &C::op<ISC,InX>, 
-/*0xE4*/    &C::op<CPX,ZP>,  &C::op<SBC,ZP>,  &C::op<INC,ZP>,  &C::op<ISC,ZP>,  
-/*0xE8*/    &C::op<INX,Imp>, &C::op<SBC,Imm>, &C::op<NOP,Imp>, &C::op<SBC,Imm>, 
-/*0xEC*/    &C::op<CPX,Ab>,  &C::op<SBC,Ab>,  &C::op<INC,Ab>,  &C::op<ISC,Ab>,  
-/*0xF0*/    &C::op<BEQ,Imm>, &C::op<SBC,InY>, &C::op<STP,Imp>, &C::op<ISC,InYS>, 
-/*0xF4*/    &C::op<NOP,ZPX>, &C::op<SBC,ZPX>, &C::op<INC,ZPX>, &C::op<ISC,ZPX>, 
-/*0xF8*/    &C::op<SED,Imp>, &C::op<SBC,AbY>, &C::op<NOP,Imp>, &C::op<ISC,AbYS>, 
-/*0xFC*/    &C::op<NOP,AbX>, &C::op<SBC,AbX>, &C::op<INC,AbXS>,&C::op<ISC,AbXS>, 
+#define NOS_OPCODE_ENTRY(code, i, am) &C::op<i,am>,
+            NOS_OPCODE_MAP(NOS_OPCODE_ENTRY)
+#undef NOS_OPCODE_ENTRY
         };
 
-        uint8_t opcode = mem_read(PC++);
         (this->*(dispatch_table[opcode]))();
-        
-        if(should_interrupt)
-        {
-            // Dummy read the next opcode and discard it (inserting BRK into the
-            // instruction register) to allow overlapped final cycle of previous
-            // instruction to complete, if necessary
-            mem_read(PC);
-
-            is_interrupt = true;
-            op<BRK,Imp>();
-            is_interrupt = false;
-        }
+#endif
+        end_instruction();
     }
 };
 
 
 
 
-template<> inline void CPU::get_effective_operand<Imp>() 
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<Imp>) 
 {
     // First byte of 'operand' (which does not exist) is read/discarded
     mem_read(PC); 
     effective_operand = 0; 
 }
 
-template<> inline void CPU::get_effective_operand<Acc>() 
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<Acc>) 
 {
     // First byte of 'operand' (which does not exist) is read/discarded
     mem_read(PC);
     effective_operand = A; 
 }
 
-template<> inline void CPU::get_effective_operand<Imm>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<Imm>)
 { 
-    uint8_t immediate = mem_read(PC++);
+    uint8_t immediate = fetch_operand_byte();
     effective_operand = immediate;
 }
 
-template<> inline void CPU::get_effective_operand<ZP>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<ZP>)
 {
-    uint8_t index = mem_read(PC++);
+    uint8_t index = fetch_operand_byte();
     effective_operand = index;
 }
 
 
-inline void CPU::get_effective_operand_ZP_(uint8_t reg)
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand_ZP_(uint8_t reg)
 {
-    uint8_t index = mem_read(PC++);
+    uint8_t index = fetch_operand_byte();
     
     mem_read(index);
     index += reg;
     effective_operand = index;
 }
 
-template<> inline void CPU::get_effective_operand<ZPX>() 
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<ZPX>) 
 { 
     get_effective_operand_ZP_(X); 
 }
 
-template<> inline void CPU::get_effective_operand<ZPY>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<ZPY>)
 {
    get_effective_operand_ZP_(Y); 
 }
 
 
-template<> inline void CPU::get_effective_operand<Ab>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<Ab>)
 {
-    uint8_t lsb = mem_read(PC++);
-
-    uint8_t msb = mem_read(PC++);
-    uint16_t index = (msb << 8) | lsb;
+    uint16_t index = fetch_operand_word();
     effective_operand = index;
 }
 
-inline void CPU::get_effective_operand_page_boundary(uint8_t lsb, uint8_t msb, 
-        uint8_t reg, bool is_write_involved)
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand_page_boundary(uint8_t lsb, 
+        uint8_t msb, uint8_t reg, bool is_write_involved)
 {
     uint16_t index;
     lsb += reg;
@@ -1214,42 +2786,48 @@ inline void CPU::get_effective_operand_page_boundary(uint8_t lsb, uint8_t msb,
     effective_operand = index;
 }
 
-inline void CPU::get_effective_operand_Ab__(uint8_t reg, bool is_write_involved)
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand_Ab__(uint8_t reg, 
+        bool is_write_involved)
 {
-    uint8_t lsb = mem_read(PC++);
-    
-    uint8_t msb = mem_read(PC++);
+    uint16_t index = fetch_operand_word();
+    uint8_t lsb = index % 0x100;
+    uint8_t msb = index >> 8;
 
     get_effective_operand_page_boundary(lsb, msb, reg, is_write_involved);
 }
 
-template<> inline void CPU::get_effective_operand<AbX>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<AbX>)
 {
     get_effective_operand_Ab__(X, false);
 }
 
-template<> inline void CPU::get_effective_operand<AbXS>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<AbXS>)
 {
     get_effective_operand_Ab__(X, true);
 }
 
-template<> inline void CPU::get_effective_operand<AbY>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<AbY>)
 {
     get_effective_operand_Ab__(Y, false);
 }
 
-template<> inline void CPU::get_effective_operand<AbYS>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<AbYS>)
 {
     get_effective_operand_Ab__(Y, true);
 }
 
 
-template<> inline void CPU::get_effective_operand<In>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<In>)
 {
-    uint8_t fst_lsb = mem_read(PC++);
-
-    uint8_t fst_msb = mem_read(PC++);
-    uint16_t index = (fst_msb << 8) | fst_lsb;
+    uint16_t index = fetch_operand_word();
+    uint8_t fst_lsb = index % 0x100;
+    uint8_t fst_msb = index >> 8;
 
     uint8_t snd_lsb = mem_read(index);
     ++fst_lsb;
@@ -1260,9 +2838,10 @@ template<> inline void CPU::get_effective_operand<In>()
     effective_operand = index;
 }
 
-template<> inline void CPU::get_effective_operand<InX>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<InX>)
 {
-    uint8_t index = mem_read(PC++);
+    uint8_t index = fetch_operand_byte();
 
     mem_read(index);
     index += X;
@@ -1275,9 +2854,10 @@ template<> inline void CPU::get_effective_operand<InX>()
     effective_operand = new_index;
 }
 
-inline void CPU::get_effective_operand_InY_(bool is_write_involved)
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand_InY_(bool is_write_involved)
 {
-    uint8_t index = mem_read(PC++);
+    uint8_t index = fetch_operand_byte();
 
     uint8_t lsb = mem_read(index);
 
@@ -1287,12 +2867,14 @@ inline void CPU::get_effective_operand_InY_(bool is_write_involved)
     get_effective_operand_page_boundary(lsb, msb, Y, is_write_involved);
 }
 
-template<> inline void CPU::get_effective_operand<InY>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<InY>)
 {
     get_effective_operand_InY_(false);
 }
 
-template<> inline void CPU::get_effective_operand<InYS>()
+template<class Cart>
+void Basic_CPU<Cart>::get_effective_operand(AddrMode_Tag<InYS>)
 {
     get_effective_operand_InY_(true);
 }
@@ -1300,34 +2882,47 @@ template<> inline void CPU::get_effective_operand<InYS>()
 
 
 
-template<AddrMode am>
-uint8_t CPU::read_data() { return mem_read(effective_operand); }
+template<class Cart> template<AddrMode am>
+uint8_t Basic_CPU<Cart>::read_data(AddrMode_Tag<am>)
+{
+    return mem_read(effective_operand);
+}
 
-template<> inline uint8_t CPU::read_data<Acc>() { return effective_operand; }
-template<> inline uint8_t CPU::read_data<Imm>() { return effective_operand; }
-template<> inline uint8_t CPU::read_data<In>()  { return effective_operand; }
+template<class Cart>
+uint8_t Basic_CPU<Cart>::read_data(AddrMode_Tag<Acc>)
+{
+    return effective_operand;
+}
 
-// For the Imp addressing mode, 'reading' makes no sense
-template<> inline uint8_t CPU::read_data<Imp>() = delete;
+template<class Cart>
+uint8_t Basic_CPU<Cart>::read_data(AddrMode_Tag<Imm>)
+{
+    return effective_operand;
+}
 
+template<class Cart>
+uint8_t Basic_CPU<Cart>::read_data(AddrMode_Tag<In>)
+{
+    return effective_operand;
+}
 
 
 
-template<AddrMode am>
-void CPU::write_data(uint8_t data) { mem_write(effective_operand, data); }
 
-template<> inline void CPU::write_data<Acc>(uint8_t data) { A = data; }
+template<class Cart> template<AddrMode am>
+void Basic_CPU<Cart>::write_data(AddrMode_Tag<am>, uint8_t data)
+{
+    mem_write(effective_operand, data);
+}
 
-// For the Imp/Imm addressing modes, 'writing' makes no sense
-template<> inline void CPU::write_data<Imp>(uint8_t) = delete;
-template<> inline void CPU::write_data<Imm>(uint8_t) = delete;
+template<class Cart>
+void Basic_CPU<Cart>::write_data(AddrMode_Tag<Acc>, uint8_t data)
+{
+    A = data;
+}
 
-// Writing with these addressing modes (the non-__S variants, i.e. not
-// safeguarded against page-boundary optimisation) is forbidden
-template<> inline void CPU::write_data<AbX>(uint8_t) = delete;
-template<> inline void CPU::write_data<AbY>(uint8_t) = delete;
-template<> inline void CPU::write_data<InY>(uint8_t) = delete;
 
+using CPU = Basic_CPU<Cartridge>;
 
 }
 
@@ -0,0 +1,68 @@
+#ifndef  DECODE_CACHE_H_NOS
+#define  DECODE_CACHE_H_NOS
+
+#include <cstdint>      // uint8_t, uint16_t
+#include <memory>       // unique_ptr, make_unique
+
+namespace NES
+{
+
+
+// Per-address cache of information derived from the instruction stream of
+// read-only CPU pages (i.e. PRG-ROM), built lazily. Each page remembers which
+// host memory it was derived from (see Shared_Bus::cpu_page_read), so that
+// when a mapper switches banks, entries of the affected pages are discarded on
+// their next lookup.
+template<class Entry>
+class Decode_Cache
+{
+  private:
+    struct Page
+    {
+        const uint8_t* src = nullptr;
+        bool is_valid[0x100] = {false};
+        Entry entries[0x100];
+    };
+
+    std::unique_ptr<Page> pages[0x100];
+
+  public:
+    // Returns nullptr unless an entry for addr was derived from the memory
+    // at src (the host memory currently mapped at the page of addr)
+    Entry* find(uint16_t addr, const uint8_t* src)
+    {
+        Page* page = pages[addr >> 8].get();
+        if(!page || (page->src != src) || !page->is_valid[addr % 0x100])
+            return nullptr;
+
+        return &(page->entries[addr % 0x100]);
+    }
+
+    // Invalidates the page of addr if it was derived from other memory
+    Entry& insert(uint16_t addr, const uint8_t* src)
+    {
+        std::unique_ptr<Page>& page = pages[addr >> 8];
+        if(!page)
+        {
+            page = std::make_unique<Page>();
+        }
+        if(page->src != src)
+        {
+            page->src = src;
+            for(bool& is_valid : page->is_valid) is_valid = false;
+        }
+
+        page->is_valid[addr % 0x100] = true;
+        return page->entries[addr % 0x100];
+    }
+
+    void clear()
+    {
+        for(std::unique_ptr<Page>& page : pages) page.reset();
+    }
+};
+
+
+}
+
+#endif //DECODE_CACHE_H_NOS
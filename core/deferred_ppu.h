@@ -0,0 +1,170 @@
+#ifndef  DEFERRED_PPU_H_NOS
+#define  DEFERRED_PPU_H_NOS
+
+#include "shared_bus.h"
+#include "cart.h"
+#include "ppu.h"
+
+#include <cstdint>      // uint64_t
+#include <condition_variable>
+#include <memory>       // unique_ptr
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NES
+{
+
+
+// Generates the pixels of a console's PPU on a worker thread: the console's
+// own PPU keeps running every frame with its pixels skipped (it still fetches
+// and evaluates sprites, for the sake of whatever the CPU can observe), while
+// a replica PPU with its own cartridge and nametables replays the Ppu_Input
+// log of each frame, reaching the same state at the same cycles and hence
+// producing the same frames
+template<class Cart>
+class Deferred_Renderer
+{
+  private:
+    // Inputs logged up to cycle end (once submitted)
+    struct Batch
+    {
+        vector<Ppu_Input> inputs;
+        uint64_t end = 0;
+    };
+
+    // Frames the CPU thread may run ahead of the worker
+    static constexpr unsigned int batch_num = 4;
+
+    Shared_Bus& shared_bus;
+    uint64_t frame_count;
+
+    Shared_Bus replica_bus;
+    std::unique_ptr<Cart> replica_cart;
+    Basic_PPU<Cart> replica;
+
+    // Batches [replayed, submitted) are queued for the worker; the CPU
+    // thread logs into batch (submitted % batch_num) meanwhile
+    Batch batches[batch_num];
+    uint64_t replayed = 0;
+    uint64_t submitted = 0;
+    bool is_stopping = false;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    std::thread worker;
+
+    void catch_up_replica(uint64_t cycle)
+    {
+        replica.catch_up((cycle - replica_bus.cycle_count) / 4);
+    }
+
+    void replay(const Batch& batch)
+    {
+        for(const Ppu_Input& input : batch.inputs)
+        {
+            catch_up_replica(input.cycle);
+            switch(input.type)
+            {
+                case(Ppu_Input::READ):
+                    replica.read_reg(input.addr % 8);
+                    break;
+                case(Ppu_Input::WRITE):
+                    if(input.addr < 0x4000)
+                        replica.write_reg(input.addr % 8, input.data);
+                    else
+                        replica_cart->cpu_write(replica_bus, input.addr,
+                                                input.data);
+                    break;
+                case(Ppu_Input::FRAME_SKIP):
+                    replica_bus.is_frame_skip_requested = input.data;
+                    break;
+            }
+        }
+        catch_up_replica(batch.end);
+    }
+
+    void run_worker()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            cond.wait(lock, [this]{ return (is_stopping ||
+                                            (replayed != submitted)); });
+            if(replayed == submitted) break;
+
+            lock.unlock();
+            replay(batches[replayed % batch_num]);
+            lock.lock();
+
+            ++replayed;
+            cond.notify_all();
+        }
+    }
+
+    void submit()
+    {
+        Batch& batch = batches[submitted % batch_num];
+        batch.end = shared_bus.cycle_count;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        ++submitted;
+        cond.notify_all();
+        cond.wait(lock, [this]{ return (submitted - replayed < batch_num); });
+        lock.unlock();
+
+        Batch& next = batches[submitted % batch_num];
+        next.inputs.clear();
+        shared_bus.ppu_input_log = &next.inputs;
+    }
+
+  public:
+    // Precondition: the console (of shared_bus and cart) is at power-on, i.e.
+    // hasn't executed anything yet
+    Deferred_Renderer(Shared_Bus& shared_bus, const Cart& cart)
+        : shared_bus(shared_bus),
+          frame_count(shared_bus.get_frame_count()),
+          replica_cart(static_cast<Cart*>(cart.clone().release())),
+          replica(replica_bus, *replica_cart)
+    {
+        shared_bus.ppu_input_log = &batches[0].inputs;
+        worker = std::thread(&Deferred_Renderer::run_worker, this);
+    }
+
+    // To be invoked after each instruction; hands the inputs logged so far
+    // over to the worker once a frame has been completed
+    void poll()
+    {
+        if(shared_bus.get_frame_count() != frame_count)
+        {
+            frame_count = shared_bus.get_frame_count();
+            submit();
+        }
+    }
+
+    // Blocks until every completed frame has been replayed
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]{ return (replayed == submitted); });
+    }
+
+    // Where the replica publishes its frames
+    Shared_Bus& get_bus() { return replica_bus; }
+
+    ~Deferred_Renderer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            is_stopping = true;
+        }
+        cond.notify_all();
+        worker.join();
+        shared_bus.ppu_input_log = nullptr;
+    }
+};
+
+
+}
+
+#endif //DEFERRED_PPU_H_NOS
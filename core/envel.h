@@ -10,15 +10,18 @@ namespace NES
 class Envelope
 {
   private:
-    bool start;
-    bool use_const_vol;
+    bool start = false;
+    bool use_const_vol = false;
     uint8_t const_vol : 4;
     uint8_t div_ctr : 4;
     uint8_t decay_lvl_ctr : 4;
     bool& lectr_halt;
 
   public:
-    Envelope(bool& lectr_halt) : lectr_halt(lectr_halt) {}
+    Envelope(bool& lectr_halt)
+        : const_vol(0), div_ctr(0), decay_lvl_ctr(0), lectr_halt(lectr_halt)
+    {
+    }
 
     void write_a(uint8_t data)
     {
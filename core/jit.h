@@ -0,0 +1,396 @@
+#ifndef  JIT_H_NOS
+#define  JIT_H_NOS
+
+#if !(defined(__x86_64__) && defined(__linux__))
+#error "The JIT backend (NOS_CPU_JIT) requires x86-64 Linux"
+#endif
+
+#include <cstdint>      // uint8_t, uint16_t, int32_t, uint64_t, uintptr_t
+#include <cstddef>      // size_t
+#include <cstring>      // memcpy
+#include <initializer_list>
+#include <utility>      // pair
+#include <vector>
+
+#include <sys/mman.h>   // mmap, mprotect, munmap
+#include <unistd.h>     // sysconf
+
+namespace NES
+{
+
+
+// Memory for generated x86-64 code (System V ABI), with an assembler for the
+// (few) instruction forms the CPU's recompiler needs. Code is emitted
+// append-only, a block at a time, and memory is never writable and executable
+// at once: the pages a block is emitted into are only made writable by
+// begin_block(), and executable again (read-only) by end_block(). Once full,
+// all code is discarded at once by reset()
+class X64_Code_Buffer
+{
+  public:
+    enum Reg : uint8_t
+    {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8,  R9,  R10, R11, R12, R13, R14, R15
+    };
+
+    // Condition codes (of jcc/setcc)
+    enum Cond : uint8_t
+    {
+        BELOW = 0x2, ABOVE_EQUAL = 0x3, EQUAL = 0x4, NOT_EQUAL = 0x5,
+        ABOVE = 0x7,
+        ZERO = EQUAL, NOT_ZERO = NOT_EQUAL
+    };
+
+    // Arithmetic/logic operations, by their opcode extension (/digit)
+    enum Alu : uint8_t
+    {
+        ADD = 0, OR = 1, AND = 4, SUB = 5, XOR = 6, CMP = 7
+    };
+
+    // Memory operand [base + (index << scale) + disp] (no index if RSP)
+    struct Mem
+    {
+        Reg base;
+        Reg index;
+        uint8_t scale;
+        int32_t disp;
+    };
+
+    static Mem mem(Reg base, int32_t disp)
+    {
+        return { base, RSP, 0, disp };
+    }
+
+    static Mem mem(Reg base, Reg index, int32_t disp, uint8_t scale = 0)
+    {
+        return { base, index, scale, disp };
+    }
+
+    using Label = size_t;
+
+  private:
+    static constexpr size_t capacity = 1U << 22;
+
+    // Generous bounds on the code of one 6502 instruction (including its
+    // out-of-line paths), and on that of a block's entry/exit
+    static constexpr size_t max_instr_size = 512;
+    static constexpr size_t max_frame_size = 64;
+
+    uint8_t* mem_begin = nullptr;
+    size_t size = 0;
+
+    size_t block_start = 0;
+
+    // Pages made writable by begin_block()
+    uint8_t* unprotected_begin = nullptr;
+    size_t unprotected_size = 0;
+
+    std::vector<size_t> label_offsets;
+    std::vector<std::pair<size_t, Label>> label_patches;
+    static constexpr size_t unbound = ~size_t(0);
+
+    void emit(std::initializer_list<uint8_t> bytes)
+    {
+        for(uint8_t byte : bytes) mem_begin[size++] = byte;
+    }
+
+    template<class T>
+    void emit_imm(T imm)
+    {
+        memcpy(mem_begin + size, &imm, sizeof(imm));
+        size += sizeof(imm);
+    }
+
+    void emit_rex(bool is_64, uint8_t reg, uint8_t index, uint8_t base)
+    {
+        uint8_t rex = 0x40 | (is_64 ? 0x8 : 0) | ((reg >> 3) << 2) |
+                      ((index >> 3) << 1) | (base >> 3);
+        if(rex != 0x40) emit({ rex });
+    }
+
+    // [prefix] [REX] opcode ModRM(reg, m) [SIB] disp32: disp32 is always
+    // present, so that rbp/r13 need no special case as a base
+    void emit_mem_op(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                     const Mem& m, bool is_64 = false, uint8_t prefix = 0)
+    {
+        if(prefix) emit({ prefix });
+        emit_rex(is_64, reg, (m.index != RSP) ? m.index : 0, m.base);
+        emit(opcode);
+
+        bool has_sib = ((m.index != RSP) || ((m.base & 7) == RSP));
+        uint8_t rm = (has_sib ? 4 : (m.base & 7));
+        emit({ uint8_t(0x80 | ((reg & 7) << 3) | rm) });
+        if(has_sib)
+            emit({ uint8_t((m.scale << 6) | ((m.index & 7) << 3) |
+                           (m.base & 7)) });
+        emit_imm(m.disp);
+    }
+
+    // [prefix] [REX] opcode ModRM(reg, rm) for a register operand rm. Byte
+    // registers are only ever al/cl/dl/bl or r8b-r15b, which need no REX of
+    // their own
+    void emit_reg_op(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                     uint8_t rm, bool is_64 = false, uint8_t prefix = 0)
+    {
+        if(prefix) emit({ prefix });
+        emit_rex(is_64, reg, 0, rm);
+        emit(opcode);
+        emit({ uint8_t(0xC0 | ((reg & 7) << 3) | (rm & 7)) });
+    }
+
+    void emit_label_ref(Label label)
+    {
+        label_patches.push_back({ size, label });
+        emit_imm(int32_t(0));
+    }
+
+    bool protect(int prot)
+    {
+        return (mprotect(unprotected_begin, unprotected_size, prot) == 0);
+    }
+
+  public:
+    X64_Code_Buffer()
+    {
+        void* addr = mmap(nullptr, capacity, PROT_READ | PROT_EXEC,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(addr != MAP_FAILED) mem_begin = static_cast<uint8_t*>(addr);
+    }
+
+    ~X64_Code_Buffer()
+    {
+        if(mem_begin) munmap(mem_begin, capacity);
+    }
+
+    X64_Code_Buffer(const X64_Code_Buffer&) = delete;
+    X64_Code_Buffer& operator=(const X64_Code_Buffer&) = delete;
+
+    // Whether a block of the given number of 6502 instructions fits (false if
+    // the buffer could not be allocated at all)
+    bool has_room(size_t instr_num)
+    {
+        return (mem_begin &&
+                (size + (instr_num * max_instr_size) + max_frame_size) <=
+                capacity);
+    }
+
+    void reset() { size = 0; }
+
+    // Precondition: has_room(instr_num); returns false if the memory cannot
+    // be made writable
+    bool begin_block(size_t instr_num)
+    {
+        block_start = size;
+        label_offsets.clear();
+        label_patches.clear();
+
+        uintptr_t page_size = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = reinterpret_cast<uintptr_t>(mem_begin + size);
+        uintptr_t end = begin + (instr_num * max_instr_size) + max_frame_size;
+        begin &= ~(page_size - 1);
+        end = (end + page_size - 1) & ~(page_size - 1);
+
+        unprotected_begin = reinterpret_cast<uint8_t*>(begin);
+        unprotected_size = end - begin;
+        return protect(PROT_READ | PROT_WRITE);
+    }
+
+    using Block = void(*)(void*);
+
+    // Returns null if the memory cannot be made executable again
+    Block end_block()
+    {
+        for(const auto& [patch, label] : label_patches)
+        {
+            int32_t rel = int32_t(label_offsets[label] - (patch + 4));
+            memcpy(mem_begin + patch, &rel, sizeof(rel));
+        }
+
+        if(!protect(PROT_READ | PROT_EXEC))
+            return nullptr;
+        return reinterpret_cast<Block>(mem_begin + block_start);
+    }
+
+    Label new_label()
+    {
+        label_offsets.push_back(unbound);
+        return label_offsets.size() - 1;
+    }
+
+    void bind(Label label) { label_offsets[label] = size; }
+
+    // Whether any jump to the label has been emitted
+    bool is_referenced(Label label) const
+    {
+        for(const auto& patch : label_patches)
+        {
+            if(patch.second == label) return true;
+        }
+        return false;
+    }
+
+    // Instructions, named after their mnemonics; operands are 32-bit unless
+    // the name or is_64 says otherwise (32-bit results are zero-extended)
+
+    void push(Reg r)
+    {
+        emit_rex(false, 0, 0, r);
+        emit({ uint8_t(0x50 | (r & 7)) });
+    }
+
+    void pop(Reg r)
+    {
+        emit_rex(false, 0, 0, r);
+        emit({ uint8_t(0x58 | (r & 7)) });
+    }
+
+    void ret() { emit({ 0xC3 }); }
+
+    template<class Func>
+    void call(Func* func)
+    {
+        mov64(RAX, reinterpret_cast<uintptr_t>(func));
+        emit({ 0xFF, 0xD0 });                   // call rax
+    }
+
+    void jmp(Label label)
+    {
+        emit({ 0xE9 });
+        emit_label_ref(label);
+    }
+
+    void jcc(Cond cond, Label label)
+    {
+        emit({ 0x0F, uint8_t(0x80 | cond) });
+        emit_label_ref(label);
+    }
+
+    void setcc(Cond cond, Reg dst)
+    {
+        emit_reg_op({ 0x0F, uint8_t(0x90 | cond) }, 0, dst);
+    }
+
+    void setcc(Cond cond, const Mem& dst)
+    {
+        emit_mem_op({ 0x0F, uint8_t(0x90 | cond) }, 0, dst);
+    }
+
+    void mov(Reg dst, uint32_t imm)
+    {
+        emit_rex(false, 0, 0, dst);
+        emit({ uint8_t(0xB8 | (dst & 7)) });
+        emit_imm(imm);
+    }
+
+    void mov64(Reg dst, uint64_t imm)
+    {
+        emit_rex(true, 0, 0, dst);
+        emit({ uint8_t(0xB8 | (dst & 7)) });
+        emit_imm(imm);
+    }
+
+    void mov(Reg dst, Reg src, bool is_64 = false)
+    {
+        emit_reg_op({ 0x89 }, src, dst, is_64);
+    }
+
+    void mov64(Reg dst, const Mem& src)
+    {
+        emit_mem_op({ 0x8B }, dst, src, true);
+    }
+
+    void movzx8(Reg dst, Reg src) { emit_reg_op({ 0x0F, 0xB6 }, dst, src); }
+
+    void movzx8(Reg dst, const Mem& src)
+    {
+        emit_mem_op({ 0x0F, 0xB6 }, dst, src);
+    }
+
+    void store8(const Mem& dst, Reg src) { emit_mem_op({ 0x88 }, src, dst); }
+
+    void store16(const Mem& dst, Reg src)
+    {
+        emit_mem_op({ 0x89 }, src, dst, false, 0x66);
+    }
+
+    void store8(const Mem& dst, uint8_t imm)
+    {
+        emit_mem_op({ 0xC6 }, 0, dst);
+        emit_imm(imm);
+    }
+
+    void store16(const Mem& dst, uint16_t imm)
+    {
+        emit_mem_op({ 0xC7 }, 0, dst, false, 0x66);
+        emit_imm(imm);
+    }
+
+    void lea(Reg dst, const Mem& src) { emit_mem_op({ 0x8D }, dst, src); }
+
+    void alu(Alu op, Reg dst, Reg src, bool is_64 = false)
+    {
+        emit_reg_op({ uint8_t((op << 3) | 0x1) }, src, dst, is_64);
+    }
+
+    void alu(Alu op, Reg dst, int32_t imm, bool is_64 = false)
+    {
+        emit_reg_op({ 0x81 }, op, dst, is_64);
+        emit_imm(imm);
+    }
+
+    void alu8(Alu op, Reg dst, uint8_t imm)
+    {
+        emit_reg_op({ 0x80 }, op, dst);
+        emit_imm(imm);
+    }
+
+    void alu(Alu op, const Mem& dst, Reg src, bool is_64 = false)
+    {
+        emit_mem_op({ uint8_t((op << 3) | 0x1) }, src, dst, is_64);
+    }
+
+    void alu8(Alu op, const Mem& dst, uint8_t imm)
+    {
+        emit_mem_op({ 0x80 }, op, dst);
+        emit_imm(imm);
+    }
+
+    void alu64(Alu op, const Mem& dst, int32_t imm)
+    {
+        emit_mem_op({ 0x81 }, op, dst, true);
+        emit_imm(imm);
+    }
+
+    void test8(Reg a, Reg b) { emit_reg_op({ 0x84 }, b, a); }
+    void test64(Reg a, Reg b) { emit_reg_op({ 0x85 }, b, a, true); }
+
+    void test8(const Mem& a, uint8_t imm)
+    {
+        emit_mem_op({ 0xF6 }, 0, a);
+        emit_imm(imm);
+    }
+
+    void test16(const Mem& a, uint16_t imm)
+    {
+        emit_mem_op({ 0xF7 }, 0, a, false, 0x66);
+        emit_imm(imm);
+    }
+
+    void shl(Reg dst, uint8_t imm)
+    {
+        emit_reg_op({ 0xC1 }, 4, dst);
+        emit_imm(imm);
+    }
+
+    void shr(Reg dst, uint8_t imm)
+    {
+        emit_reg_op({ 0xC1 }, 5, dst);
+        emit_imm(imm);
+    }
+};
+
+
+}
+
+#endif //JIT_H_NOS
@@ -20,11 +20,11 @@ class Length_Counter
         0xC0, 0x18, 0x48, 0x1A, 0x10, 0x1C, 0x20, 0x1E 
     };
 
-    bool enabled;
-    uint8_t clock;
+    bool enabled = false;
+    uint8_t clock = 0;
 
   public:
-    bool halt;
+    bool halt = false;
 
     void set_enabled(bool val)
     {
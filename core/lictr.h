@@ -10,13 +10,16 @@ namespace NES
 class Linear_Counter
 {
   private:
-    bool should_reload;
+    bool should_reload = false;
     uint8_t clock_reload : 7;
     uint8_t clock : 7;
     bool& lectr_halt;
 
   public:
-    Linear_Counter(bool& lectr_halt) : lectr_halt(lectr_halt) {}
+    Linear_Counter(bool& lectr_halt)
+        : clock_reload(0), clock(0), lectr_halt(lectr_halt)
+    {
+    }
 
     bool is_active() { return (clock > 0); }
 
@@ -16,8 +16,8 @@ struct N_Timer
         0x00CA, 0x00FE, 0x017C, 0x01FC, 0x02FA, 0x03F8, 0x07F2, 0x0FE4
     };
 
-    uint16_t clock_reload;
-    uint16_t clock;
+    uint16_t clock_reload = 0;
+    uint16_t clock = 0;
 
     void write_c(uint8_t data)
     {
@@ -41,6 +41,23 @@ struct N_Timer
 
         return pulse_seq;
     }
+
+    // Equivalent to calling pulse_clock() num times; returns the number of
+    // pulses
+    uint32_t advance(uint32_t num)
+    {
+        if(num <= clock)
+        {
+            clock -= num;
+            return 0;
+        }
+
+        // The first pulse, then one every (clock_reload + 1) clocks
+        num -= (clock + 1);
+        uint32_t period = uint32_t(clock_reload) + 1;
+        clock = clock_reload - (num % period);
+        return (1 + (num / period));
+    }
 };
 
 
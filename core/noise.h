@@ -1,6 +1,8 @@
 #ifndef  NOISE_H_NOS
 #define  NOISE_H_NOS
 
+#include <cstdint>      // uint16_t, uint32_t
+
 #include "n_timer.h"
 #include "lectr.h"
 #include "envel.h"
@@ -9,6 +11,46 @@ namespace NES
 {
 
 
+// The shift register's feedback is linear (over GF(2)), so any number of its
+// steps amounts to a product of matrices; lfsr_jump_table holds, for each
+// mode, those of 2^i steps, as the images of the register's 15 unit vectors
+struct LFSR_Jump_Table
+{
+    enum : unsigned int { bits = 15, levels = 32 };
+
+    uint16_t cols[2][levels][bits];
+
+    static constexpr uint16_t step(uint16_t reg, bool mode)
+    {
+        unsigned int xor_bit = (mode ? 6 : 1);
+        uint16_t feedback = ((reg >> 0) ^ (reg >> xor_bit)) & 1U;
+        return ((reg >> 1) | (feedback << 14));
+    }
+
+    constexpr uint16_t apply(bool mode, unsigned int level, uint16_t reg) const
+    {
+        uint16_t result = 0;
+        for(unsigned int i = 0; i < bits; ++i)
+            if(reg & (1U << i)) result ^= cols[mode][level][i];
+        return result;
+    }
+
+    constexpr LFSR_Jump_Table() : cols()
+    {
+        for(unsigned int mode = 0; mode < 2; ++mode)
+        {
+            for(unsigned int i = 0; i < bits; ++i)
+                cols[mode][0][i] = step(1U << i, mode);
+            for(unsigned int level = 1; level < levels; ++level)
+                for(unsigned int i = 0; i < bits; ++i)
+                    cols[mode][level][i] = apply(mode, level - 1, 
+                        cols[mode][level - 1][i]);
+        }
+    }
+};
+
+constexpr LFSR_Jump_Table lfsr_jump_table;
+
 class Noise
 {
   private:
@@ -17,7 +59,7 @@ class Noise
     Envelope envel;
 
     uint16_t shift_reg : 15;
-    bool mode;
+    bool mode = false;
 
   public:
     Noise() : envel(lectr.halt), shift_reg(1U) {}
@@ -62,6 +104,22 @@ class Noise
         }
     }
 
+    // As Pulse::advance() and Pulse::ticks_until_change()
+    void advance(uint32_t ticks)
+    {
+        uint32_t steps = timer.advance(ticks);
+        uint16_t reg = shift_reg;
+        for(unsigned int level = 0; steps > 0; ++level, steps >>= 1)
+            if(steps & 1U) reg = lfsr_jump_table.apply(mode, level, reg);
+        shift_reg = reg;
+    }
+
+    uint32_t ticks_until_change()
+    {
+        bool is_silent = (!lectr.is_active() || (envel.vol() == 0));
+        return (is_silent ? 0 : timer.clock + 1);
+    }
+
     void tick_frame_quarter()
     {
         envel.tick_frame_quarter();
@@ -0,0 +1,58 @@
+#ifndef  OAM_SCAN_H_NOS
+#define  OAM_SCAN_H_NOS
+
+#include <cstdint>      // uint8_t, uint64_t
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace NES
+{
+
+
+// Bit i is set if sprite i of oam (64 sprites of 4 bytes, Y coordinate first)
+// covers the given scanline, i.e. scanln - Y < sprite_height. Compares 16
+// Y coordinates at a time when compiled for SSE2
+inline uint64_t find_sprites_in_range(const uint8_t (&oam)[0x100],
+                                      uint8_t scanln, uint8_t sprite_height)
+{
+    uint64_t in_range = 0;
+
+#if defined(__SSE2__)
+    const __m128i line = _mm_set1_epi8(scanln);
+    const __m128i max_dist = _mm_set1_epi8(sprite_height - 1);
+    for(unsigned int k = 0; k < 0x100; k += 0x10)
+    {
+        __m128i bytes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(oam + k));
+
+        // Unsigned byte comparisons: Y <= scanln and scanln - Y < height
+        __m128i is_above = _mm_cmpeq_epi8(_mm_max_epu8(bytes, line), line);
+        __m128i dist = _mm_subs_epu8(line, bytes);
+        __m128i is_near = _mm_cmpeq_epi8(_mm_min_epu8(dist, max_dist), dist);
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(is_above,
+                                                            is_near));
+
+        // Only the Y coordinate (every 4th byte) counts
+        uint64_t sprites = (((mask >>  0) & 1U) << 0) |
+                           (((mask >>  4) & 1U) << 1) |
+                           (((mask >>  8) & 1U) << 2) |
+                           (((mask >> 12) & 1U) << 3);
+        in_range |= sprites << (k / 4);
+    }
+#else
+    for(unsigned int i = 0; i < 0x40; ++i)
+    {
+        unsigned int dist = scanln - static_cast<unsigned int>(oam[i * 4]);
+        if(dist < sprite_height) in_range |= (uint64_t(1) << i);
+    }
+#endif
+
+    return in_range;
+}
+
+
+}
+
+#endif //OAM_SCAN_H_NOS
@@ -0,0 +1,204 @@
+#ifndef  PALETTE_H_NOS
+#define  PALETTE_H_NOS
+
+#include <cstdint>      // uint8_t, uint16_t, uint32_t
+#include <cstddef>      // size_t
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace NES
+{
+
+
+// Framebuffer pixels are 9-bit values: the 6-bit color from palette RAM (with
+// PPUMASK grayscale already applied) in bits 0-5, and the PPUMASK red, green
+// and blue emphasis bits in bits 6, 7 and 8 respectively
+enum : unsigned int
+{
+    pixel_color_bits = 6,
+    pixel_value_num  = 1U << (pixel_color_bits + 3)
+};
+
+// Colors without emphasis, as 0xAARRGGBB
+constexpr uint32_t base_palette[0x40] =
+{
+    0xFF545454, 0xFF001E74, 0xFF081090, 0xFF300088,
+    0xFF440064, 0xFF5C0030, 0xFF540400, 0xFF3C1800,
+    0xFF202A00, 0xFF083A00, 0xFF004000, 0xFF003C00,
+    0xFF00323C, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFF989698, 0xFF084CC4, 0xFF3032EC, 0xFF5C1EE4,
+    0xFF8814B0, 0xFFA01464, 0xFF982220, 0xFF783C00,
+    0xFF545A00, 0xFF287200, 0xFF087C00, 0xFF007628,
+    0xFF006678, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFFECEEEC, 0xFF4C9AEC, 0xFF787CEC, 0xFFB062EC,
+    0xFFE454EC, 0xFFEC58B4, 0xFFEC6A64, 0xFFD48820,
+    0xFFA0AA00, 0xFF74C400, 0xFF4CD020, 0xFF38CC6C,
+    0xFF38B4CC, 0xFF3C3C3C, 0xFF000000, 0xFF000000,
+    0xFFECEEEC, 0xFFA8CCEC, 0xFFBCBCEC, 0xFFD4B2EC,
+    0xFFECAEEC, 0xFFECAED4, 0xFFECB4B0, 0xFFE4C490,
+    0xFFCCD278, 0xFFB4DE78, 0xFFA8E290, 0xFF98E2B4,
+    0xFFA0D6E4, 0xFFA0A2A0, 0xFF000000, 0xFF000000
+};
+
+// Every pixel value in each output format, computed at compile time. Each
+// emphasis bit attenuates the other two channels (see
+// https://wiki.nesdev.com/w/index.php/Colour_emphasis); YUV is BT.601 with
+// limited range
+struct Palette_Table
+{
+    uint32_t argb8888[pixel_value_num];
+    uint16_t rgb565  [pixel_value_num];
+    uint32_t y[pixel_value_num];    // Widened for the 32-bit gathers
+    uint8_t  u[pixel_value_num];
+    uint8_t  v[pixel_value_num];
+    uint32_t uv[pixel_value_num];   // u | (v << 16), to sum both at once
+
+    constexpr Palette_Table() : argb8888(), rgb565(), y(), u(), v(), uv()
+    {
+        constexpr double attenuation = 0.816328;
+
+        for(unsigned int px = 0; px < pixel_value_num; ++px)
+        {
+            uint32_t base = base_palette[px % (1U << pixel_color_bits)];
+            unsigned int emphasis = px >> pixel_color_bits;
+
+            // Red, green, blue
+            double rgb[3] = { double((base >> 16) & 0xFFU),
+                              double((base >>  8) & 0xFFU),
+                              double((base >>  0) & 0xFFU) };
+            for(unsigned int c = 0; c < 3; ++c)
+                for(unsigned int e = 0; e < 3; ++e)
+                    if((e != c) && (emphasis & (1U << e)))
+                        rgb[c] *= attenuation;
+
+            uint8_t r = uint8_t(rgb[0] + 0.5);
+            uint8_t g = uint8_t(rgb[1] + 0.5);
+            uint8_t b = uint8_t(rgb[2] + 0.5);
+
+            argb8888[px] = (0xFFU << 24) | (r << 16) | (g << 8) | (b << 0);
+            rgb565[px] = ((r >> 3) << 11) | ((g >> 2) << 5) | ((b >> 3) << 0);
+            y[px] = uint8_t(16.0 +
+                ((65.738 * r) + (129.057 * g) + (25.064 * b)) / 256 + 0.5);
+            u[px] = uint8_t(128.0 +
+                ((-37.945 * r) - (74.494 * g) + (112.439 * b)) / 256 + 0.5);
+            v[px] = uint8_t(128.0 +
+                ((112.439 * r) - (94.154 * g) - (18.285 * b)) / 256 + 0.5);
+            uv[px] = u[px] | (v[px] << 16);
+        }
+    }
+};
+
+constexpr Palette_Table palette_table;
+
+
+// Conversions of framebuffer pixels into the formats above, vectorized with
+// AVX2 when compiled for it
+// Precondition (for all): each value in src < pixel_value_num
+
+inline void convert_to_argb8888(const uint16_t* src, uint32_t* dst, size_t num)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const int* table = reinterpret_cast<const int*>(palette_table.argb8888);
+    for(; i + 8 <= num; i += 8)
+    {
+        __m256i index = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            _mm256_i32gather_epi32(table, index, 4));
+    }
+#endif
+    for(; i < num; ++i)
+        dst[i] = palette_table.argb8888[src[i]];
+}
+
+inline void convert_to_rgb565(const uint16_t* src, uint16_t* dst, size_t num)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    // Gathers ARGB8888 (as the gather has no 16-bit form) and repacks it
+    const int* table = reinterpret_cast<const int*>(palette_table.argb8888);
+    auto to_rgb565 = [](__m256i argb) -> __m256i
+    {
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(argb, 8),
+                                     _mm256_set1_epi32(0xF800));
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(argb, 5),
+                                     _mm256_set1_epi32(0x07E0));
+        __m256i b = _mm256_and_si256(_mm256_srli_epi32(argb, 3),
+                                     _mm256_set1_epi32(0x001F));
+        return _mm256_or_si256(_mm256_or_si256(r, g), b);
+    };
+    for(; i + 16 <= num; i += 16)
+    {
+        __m256i index = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = to_rgb565(_mm256_i32gather_epi32(table,
+            _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index)), 4));
+        __m256i hi = to_rgb565(_mm256_i32gather_epi32(table,
+            _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1)), 4));
+
+        // packus interleaves the 128-bit lanes of its operands
+        __m256i packed = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+#endif
+    for(; i < num; ++i)
+        dst[i] = palette_table.rgb565[src[i]];
+}
+
+// Planar YUV 4:2:0 (I420): dst_y holds width * height samples, and dst_u and
+// dst_v (width / 2) * (height / 2) each, averaged over 2x2 pixel blocks
+// Precondition: width and height are even
+inline void convert_to_yuv420(const uint16_t* src,
+                              unsigned int width, unsigned int height,
+                              uint8_t* dst_y, uint8_t* dst_u, uint8_t* dst_v)
+{
+    size_t num = size_t(width) * height;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const int* table = reinterpret_cast<const int*>(palette_table.y);
+    for(; i + 16 <= num; i += 16)
+    {
+        __m256i index = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = _mm256_i32gather_epi32(table,
+            _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index)), 4);
+        __m256i hi = _mm256_i32gather_epi32(table,
+            _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1)), 4);
+
+        // Narrow 16 32-bit values to bytes, restoring their order
+        __m256i words = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(lo, hi), 0xD8);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                         _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst_y + i), bytes);
+    }
+#endif
+    for(; i < num; ++i)
+        dst_y[i] = palette_table.y[src[i]];
+
+    for(unsigned int row = 0; row < height; row += 2)
+    {
+        const uint16_t* top    = src + (size_t(row) * width);
+        const uint16_t* bottom = top + width;
+        size_t dst_i = size_t(row / 2) * (width / 2);
+        for(unsigned int col = 0; col < width; col += 2)
+        {
+            const uint32_t* table = palette_table.uv;
+            uint32_t sum = table[top[col]]    + table[top[col + 1]] +
+                           table[bottom[col]] + table[bottom[col + 1]] +
+                           ((2U << 16) | 2U);
+            dst_u[dst_i] = (sum >>  2) & 0xFFU;
+            dst_v[dst_i] = (sum >> 18) & 0xFFU;
+            ++dst_i;
+        }
+    }
+}
+
+
+}
+
+#endif //PALETTE_H_NOS
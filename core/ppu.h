@@ -3,13 +3,18 @@
 
 #include "shared_bus.h"
 #include "cart.h"
+#include "chr_cache.h"
+#include "compositor.h"
+#include "oam_scan.h"
+#include "palette.h"
 
-#include <cstdint>      // uint8_t, uint16_t, uint64_t
-#include <cstring>      // memcpy
+#include <cstdint>      // uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstring>      // memcpy, memset
 #include <vector>
 #include <utility>      //pair
 
 using std::memcpy;
+using std::memset;
 using std::vector;
 using std::pair;
 
@@ -17,11 +22,152 @@ namespace NES
 {
 
 
-class PPU
+// Kinds of scanline, by what the PPU does on their dots
+namespace Scanln_Type
+{
+    enum : uint8_t
+    {
+        VISIBLE,        // 0-239
+        POST_RENDER,    // 240
+        VBLANK_START,   // 241
+        VBLANK,         // 242-260
+        PRE_RENDER,     // 261
+        NUM
+    };
+}
+
+constexpr uint8_t get_scanln_type(uint16_t scanln)
+{
+    using namespace Scanln_Type;
+    return ((scanln <  height_px)          ? VISIBLE      :
+            (scanln == height_px)          ? POST_RENDER  :
+            (scanln == height_px + 1)      ? VBLANK_START :
+            (scanln <  scanln_height - 1)  ? VBLANK       :
+                                             PRE_RENDER);
+}
+
+// Steps which Basic_PPU::execute_cycle() may take on a dot; those up to (and
+// including) ODD_FRAME_SKIP only take place while rendering is enabled
+// https://wiki.nesdev.com/w/index.php/PPU_rendering
+namespace Dot_Action
+{
+    enum : uint32_t
+    {
+        SCROLL_X_RELOAD     = 1U << 0,
+        OAM_ADDR_RESET      = 1U << 1,
+        BG_FETCH_NT         = 1U << 2,
+        BG_FETCH_ATTR       = 1U << 3,
+        BG_FETCH_LO         = 1U << 4,
+        BG_FETCH_HI         = 1U << 5,
+        SP_FETCH            = 1U << 6,
+        SCROLL_Y_RELOAD     = 1U << 7,
+        OAM_AUX_LATCH       = 1U << 8,
+        SCROLL_X_INC        = 1U << 9,
+        SCROLL_Y_INC        = 1U << 10,
+        OAM_AUX_CLEAR       = 1U << 11,
+        SP_EVAL             = 1U << 12,
+        NT_DUMMY_FETCH      = 1U << 13,
+        ODD_FRAME_SKIP      = 1U << 14,
+
+        FRAME_START         = 1U << 15,     // Pre-render scanline, dot 0
+        FRAME_END           = 1U << 16,
+        VBLANK_SET          = 1U << 17,
+        PIXEL_OUTPUT        = 1U << 18,
+        BG_SHIFT            = 1U << 19,
+        BG_RELOAD           = 1U << 20,
+        SP_SHIFT            = 1U << 21,
+
+        RENDERING_ONLY      = (ODD_FRAME_SKIP << 1) - 1
+    };
+}
+
+constexpr uint32_t get_dot_actions(uint8_t scanln_type, uint16_t dot)
+{
+    using namespace Dot_Action;
+
+    // Every other dot of each 8-dot tile period
+    constexpr uint32_t bg_fetches[8] = 
+        { BG_FETCH_NT, 0, BG_FETCH_ATTR, 0, BG_FETCH_LO, 0, BG_FETCH_HI, 0 };
+    uint32_t bg_fetch = ((dot > 0) ? bg_fetches[(dot - 1) % 8] : 0);
+    bool is_tile_end = (dot % 8 == 0);
+
+    bool is_visible = (scanln_type == Scanln_Type::VISIBLE);
+    switch(scanln_type)
+    {
+        case(Scanln_Type::POST_RENDER):
+            return ((dot == 0) ? uint32_t(FRAME_END) : 0);
+        case(Scanln_Type::VBLANK_START):
+            return ((dot == 0) ? uint32_t(VBLANK_SET) : 0);
+        case(Scanln_Type::VBLANK):       return 0;
+        default:                         break;
+    }
+
+    uint32_t actions = 0;
+    if(dot == 0)
+    {
+        if(!is_visible) actions |= FRAME_START;
+    }
+    else if(dot <= width_px)
+    {
+        actions |= bg_fetch;
+        if(is_tile_end)             actions |= SCROLL_X_INC;
+        if(dot == width_px)         actions |= SCROLL_Y_INC;
+
+        if(dot <= 64)               actions |= OAM_AUX_CLEAR;
+        else if(is_visible)         actions |= SP_EVAL;
+
+        if(is_visible)              actions |= PIXEL_OUTPUT;
+        actions |= (BG_SHIFT | SP_SHIFT);
+        if(is_tile_end)             actions |= BG_RELOAD;
+    }
+    else if(dot <= hblank_end)
+    {
+        if(dot == width_px + 1)     actions |= SCROLL_X_RELOAD;
+        actions |= (OAM_ADDR_RESET | bg_fetch | SP_FETCH);
+        if(!is_visible && (dot >= 280) && (dot <= 304))
+            actions |= SCROLL_Y_RELOAD;
+    }
+    else if(dot < (scanln_width - 4))
+    {
+        actions |= bg_fetch;
+        if(dot == hblank_end + 1)   actions |= OAM_AUX_LATCH;
+        if(is_tile_end)             actions |= SCROLL_X_INC;
+        actions |= BG_SHIFT;
+        if(is_tile_end)             actions |= BG_RELOAD;
+    }
+    else
+    {
+        if(dot % 2)                 actions |= NT_DUMMY_FETCH;
+        if(!is_visible && (dot == scanln_width - 3))
+            actions |= ODD_FRAME_SKIP;
+    }
+
+    return actions;
+}
+
+struct Dot_Action_Table
+{
+    uint32_t actions[Scanln_Type::NUM][scanln_width];
+
+    constexpr Dot_Action_Table() : actions()
+    {
+        for(uint8_t type = 0; type < Scanln_Type::NUM; ++type)
+            for(uint16_t dot = 0; dot < scanln_width; ++dot)
+                actions[type][dot] = get_dot_actions(type, dot);
+    }
+};
+
+// Indexed by scanline type, then dot
+constexpr Dot_Action_Table dot_action_table;
+
+
+// Ricoh 2C02, connected to a cartridge of type Cart (see Basic_Console)
+template<class Cart>
+class Basic_PPU
 {
   private:
     Shared_Bus& shared_bus;
-    Cartridge& cart;
+    Cart& cart;
 
     uint8_t palette_bg[0xC] = {0};
     uint8_t palette_sp[0xC] = {0};
@@ -57,6 +203,10 @@ class PPU
     bool sprite_in_range = false;
     bool sprite_zero_in_range = false;
     bool sprite_zero_on_scanline = false;
+
+    // Whether the current frame's pixels are left out (see
+    // Shared_Bus::should_skip_frame())
+    bool is_skipping_pixels = false;
     bool oam_scanned = false;
     uint8_t sprite_count = 0;
     uint8_t overflow_cycle_count = 0;
@@ -83,7 +233,14 @@ class PPU
     uint8_t vram_read_buf;
     uint8_t oam_buf = 0;
     
+    // Position in the frame, as a cycle index and as scanline/dot counters
+    // (kept in step, to avoid dividing on every cycle)
     uint64_t cycle_count;
+    uint16_t dot_count;
+    uint16_t scanln_count;
+    uint8_t scanln_type;
+    uint64_t visible_scanln_count = 0;
+    uint64_t fast_scanln_count = 0;
     uint8_t reg_latch = 0;
     bool even_odd_frame = false;
     bool nt_mirror_vert_hori = false;
@@ -111,11 +268,42 @@ class PPU
     void increment_cycle_count()
     { 
         ++cycle_count; 
-        cycle_count %= (scanln_width * scanln_height); 
+        if(++dot_count == scanln_width)
+        {
+            dot_count = 0;
+            if(++scanln_count == scanln_height)
+            {
+                scanln_count = 0;
+                cycle_count = 0;
+            }
+            scanln_type = get_scanln_type(scanln_count);
+            if(scanln_type == Scanln_Type::VISIBLE) ++visible_scanln_count;
+        }
+    }
+
+    // Precondition: cycle < (scanln_width * scanln_height)
+    void set_cycle_count(uint32_t cycle)
+    {
+        cycle_count = cycle;
+        dot_count = cycle % scanln_width;
+        scanln_count = cycle / scanln_width;
+        scanln_type = get_scanln_type(scanln_count);
     }
 
     uint8_t sprite_height() { return (ctrl_sprites_large ? 16 : 8); }
 
+    static constexpr uint16_t color_mask = ~(0xFFFFU << pixel_color_bits);
+
+    // Framebuffer pixel value (see palette.h) of a palette RAM entry, as 
+    // modified by the grayscale and emphasis bits of PPUMASK
+    uint16_t get_pixel_value(uint8_t color)
+    {
+        color &= (mask_grayscale ? 0x30 : color_mask);
+        return (color | (mask_emph_r << (pixel_color_bits + 0))
+                      | (mask_emph_g << (pixel_color_bits + 1))
+                      | (mask_emph_b << (pixel_color_bits + 2)));
+    }
+
     void set_vram_addr_bus(uint16_t addr)
     {
         vram_addr_bus = (addr % 0x4000);
@@ -128,7 +316,8 @@ class PPU
 
     bool is_render_scanln()
     {
-        return ((scanln() < height_px) || (scanln() == scanln_height - 1));
+        return ((scanln_type == Scanln_Type::VISIBLE) || 
+                (scanln_type == Scanln_Type::PRE_RENDER));
     }
 
     bool is_rendering()
@@ -158,14 +347,17 @@ class PPU
         addr %= 0x4000;
         set_vram_addr_bus(addr);
 
-        return cart.ppu_read(shared_bus, addr);
+        const uint8_t* page = shared_bus.ppu_page_read[addr >> 10];
+        return (page ? page[addr % 0x400] : cart.ppu_read(shared_bus, addr));
     }
     void cart_write(uint16_t addr, uint8_t data)
     {
         addr %= 0x4000;
         set_vram_addr_bus(addr);
 
-        cart.ppu_write(shared_bus, addr, data);
+        uint8_t* page = shared_bus.ppu_page_write[addr >> 10];
+        if(page) page[addr % 0x400] = data;
+        else     cart.ppu_write(shared_bus, addr, data);
     }
 
     uint16_t nt_addr()
@@ -281,6 +473,62 @@ class PPU
         }
     }
 
+    // Equivalent to clear_oam_aux() and perform_sprite_evaluation() over dots
+    // 1-256 of a visible scanline, derived from a single scan of the sprites'
+    // Y coordinates. Only applies if fewer than 8 sprites are in range and
+    // OAMADDR is 0 (as left by rendering the previous scanline), so that the
+    // state machine copies whole sprites and never reaches the sprite overflow
+    // check (along with its hardware bug); otherwise returns false and
+    // changes nothing
+    bool evaluate_sprites_fast()
+    {
+        if(oam_addr != 0) 
+            return false;
+
+        uint64_t in_range = find_sprites_in_range(oam, scanln(), 
+                                                  sprite_height());
+        unsigned int in_range_num = 0;
+        for(uint64_t bits = in_range; bits != 0; bits &= bits - 1)
+            ++in_range_num;
+        if(in_range_num >= 8)
+            return false;
+
+        memset(oam_aux, 0xFF, sizeof(oam_aux));
+        
+        // Sprites in range are copied in order; any other sprite only has its
+        // Y coordinate written to the next free slot (without advancing)
+        sprite_count = 0;
+        for(unsigned int i = 0; i < 0x40; ++i)
+        {
+            uint8_t* slot = oam_aux + (sprite_count * 4);
+            if(in_range & (uint64_t(1) << i))
+            {
+                memcpy(slot, oam + (i * 4), 4);
+                ++sprite_count;
+            }
+            else
+            {
+                slot[0] = oam[i * 4];
+            }
+        }
+
+        // Each sprite took one evaluation step (two dots) if out of range and
+        // four if in range; the remaining steps only advance OAMADDR and read
+        // from the next free slot
+        constexpr unsigned int step_num = (width_px - 64) / 2;
+        unsigned int scan_step_num = 0x40 + (3 * sprite_count);
+        oam_addr = 4 * (step_num - scan_step_num);
+        oam_aux_addr = sprite_count * 4;
+        oam_buf = read_oam_aux(oam_aux_addr);
+
+        sprite_in_range = false;
+        sprite_zero_in_range = (in_range & 1U);
+        sprite_zero_on_scanline = sprite_zero_in_range;
+        oam_aux_full = false;
+        oam_scanned = true;
+        overflow_cycle_count = 0;
+        return true;
+    }
     
     void increment_scroll_x_coarse()
     {
@@ -366,13 +614,13 @@ class PPU
         palette_shift_hi <<= 1;
         palette_shift_lo |= ((bg_palette_latch >> 0) & 1U);
         palette_shift_hi |= ((bg_palette_latch >> 1) & 1U);
+    }
 
-        if(dot() % 0x8 == 0)
-        {
-            bg_tile_shift_lo |= next_bg_tile_lo;
-            bg_tile_shift_hi |= next_bg_tile_hi;
-            bg_palette_latch  = next_bg_palette;
-        }
+    void reload_bg_registers()
+    {
+        bg_tile_shift_lo |= next_bg_tile_lo;
+        bg_tile_shift_hi |= next_bg_tile_hi;
+        bg_palette_latch  = next_bg_palette;
     }
 
     void shift_sp_registers()
@@ -467,44 +715,48 @@ class PPU
         }
     }
 
+    // Background tile fetches, on every other dot of each 8-dot tile period
+    // (see Dot_Action); strictly, background tile operations should take two
+    // cycles each to execute; here, however, they are simulated as taking one
+    // each
     //TODO separate (see mmc3/irqspecifics)
-    void fetch_bg_tile_data()
+    void fetch_bg_nt_byte()
     {
-        // Strictly, background tile operations should take two cycles each to
-        // execute; here, however, they are simulated as taking one each
-        
-        switch(hblank_dot() % 8)
-        {
-            case(0x0):
-            {
-                uint8_t tile_index = cart_read(nt_addr());
-                tile_sliver_addr = (((ctrl_bg_pattern_table ? 1U : 0U) << 12) |
-                                    (tile_index << 4) |
-                                    (vram_addr >> 12));
-                break;
-            }
+        uint8_t tile_index = cart_read(nt_addr());
+        tile_sliver_addr = (((ctrl_bg_pattern_table ? 1U : 0U) << 12) |
+                            (tile_index << 4) |
+                            (vram_addr >> 12));
+    }
 
-            case(0x2):
-            {
-                unsigned int shamt = (((vram_addr >> 6) & 1U) << 1 |
-                                      ((vram_addr >> 1) & 1U)) * 2;
-                uint8_t mask = 0xFU >> 2;
-                next_bg_palette = (cart_read(attr_addr()) >> shamt) & mask;
-                break;
-            }
+    void fetch_bg_attr_byte()
+    {
+        unsigned int shamt = (((vram_addr >> 6) & 1U) << 1 |
+                              ((vram_addr >> 1) & 1U)) * 2;
+        uint8_t mask = 0xFU >> 2;
+        next_bg_palette = (cart_read(attr_addr()) >> shamt) & mask;
+    }
 
-            case(0x4):
-            {
-                next_bg_tile_lo = cart_read(tile_sliver_addr);
-                break;
-            }
+    void fetch_bg_tile_lo() { next_bg_tile_lo = cart_read(tile_sliver_addr); }
+    void fetch_bg_tile_hi() 
+    { 
+        next_bg_tile_hi = cart_read(tile_sliver_addr + 8); 
+    }
 
-            case(0x6):
-            {
-                next_bg_tile_hi = cart_read(tile_sliver_addr + 8);
-                break;
-            }
+    // Both pattern bytes of the current background tile row at once, for
+    // renderers which consume a tile row at a time; the pattern reads are
+    // skipped if the page map provides the row already decoded
+    Chr_Row fetch_bg_tile_row()
+    {
+        const Chr_Row* rows = shared_bus.ppu_row_page[tile_sliver_addr >> 10];
+        if(!rows)
+        {
+            fetch_bg_tile_lo();
+            fetch_bg_tile_hi();
+            return decode_chr_row(next_bg_tile_lo, next_bg_tile_hi);
         }
+
+        set_vram_addr_bus(tile_sliver_addr + 8);
+        return rows[Chr_Cache::get_row_index(tile_sliver_addr % 0x400)];
     }
 
     uint8_t get_pixel_color()
@@ -572,6 +824,206 @@ class PPU
         return ((bg_palette << 2) | bg_color);
     }
 
+    // Whether execute_cycle() would leave the NMI flag and line as they are
+    bool is_nmi_settled()
+    {
+        return ((stat_nmi_occurred == new_nmi_occurred) &&
+                (shared_bus.line_nmi_low == 
+                    (ctrl_nmi_output && stat_nmi_occurred)));
+    }
+
+    // Whether dots 1-256 of the current scanline can be rendered at once by
+    // render_scanln_fast(), given the number of cycles to be executed without
+    // the CPU intervening (so no register access can occur mid-scanline)
+    bool can_render_scanln_fast(uint32_t cycles)
+    {
+        return ((cycles >= width_px) && (dot_count == 1) && 
+                (scanln_type == Scanln_Type::VISIBLE) &&
+                is_rendering_enabled() && is_nmi_settled());
+    }
+
+    // Background tiles rendered over a scanline by render_scanln_fast()
+    static constexpr unsigned int scanln_tile_num = (width_px / 8) + 2;
+
+    // Pixels of dots 1-256 of a visible scanline from the background tiles of
+    // render_scanln_fast() and the sprite shift registers, with the sprite 0
+    // hit; the pixels are left out while skipping pixel generation
+    void output_scanln(const Chr_Row (&tile_rows)[scanln_tile_num],
+                       const uint8_t (&tile_palette)[scanln_tile_num])
+    {
+        constexpr unsigned int tile_num = scanln_tile_num;
+
+        uint8_t bg_line[tile_num * 8];
+        for(unsigned int t = 1; t < tile_num; ++t)
+        {
+            // Palette bits set in each byte with a non-zero color
+            constexpr uint64_t ones = 0x0101010101010101U;
+            uint64_t px = tile_rows[t].px;
+            uint64_t is_opaque = ((px | (px >> 1)) & ones);
+            px |= is_opaque * (tile_palette[t] << 2);
+            memcpy(bg_line + (t * 8), &px, sizeof(px));
+        }
+        // The first 8 pixels take their palette from the palette shift
+        // registers (shifted in from the latch one dot at a time)
+        memcpy(bg_line, &(tile_rows[0].px), 8);
+        for(unsigned int i = 0; i < 8; ++i)
+        {
+            unsigned int bit = 7 - i;
+            uint8_t palette = (((palette_shift_lo >> bit) & 1U) << 0) |
+                              (((palette_shift_hi >> bit) & 1U) << 1);
+            if(bg_line[i] != 0) bg_line[i] |= (palette << 2);
+        }
+
+        // Sprites: for each pixel, the entry (see Sp_Px) of the first sprite
+        // slot with an opaque pixel there; slot i starts sp_xpos[i] dots into
+        // the scanline
+        uint8_t sp_line[width_px] = {0};
+        for(unsigned int i = 8; i-- > 0; )
+        {
+            bool flip_hori = (sp_attr[i] & (1U << 6));
+            unsigned int start = sp_xpos[i];
+
+            uint8_t entry = Sp_Px::OPAQUE | ((sp_attr[i] & 0x3U) << 2);
+            if(sp_attr[i] & (1U << 5)) 
+                entry |= Sp_Px::BEHIND_BG;
+            if((i == 0) && sprite_zero_on_scanline) 
+                entry |= Sp_Px::SPRITE_ZERO;
+
+            Chr_Row row = decode_chr_row(sp_tile_shift_lo[i], 
+                                         sp_tile_shift_hi[i]);
+            uint8_t px[8];
+            memcpy(px, (flip_hori ? &(row.px_flipped) : &(row.px)), 8);
+            for(unsigned int j = 0; (j < 8) && (start + j < width_px); ++j)
+            {
+                if(px[j] != 0) sp_line[start + j] = (entry | px[j]);
+            }
+        }
+        // No sprite 0 hit at dot 256
+        sp_line[width_px - 1] &= ~Sp_Px::SPRITE_ZERO;
+
+        uint8_t* bg_px = bg_line + scroll_x_fine;
+        if(!mask_show_bg)           memset(bg_px,   0, width_px);
+        else if(!mask_show_bg_left) memset(bg_px,   0, 8);
+        if(!mask_show_sp)           memset(sp_line, 0, width_px);
+        else if(!mask_show_sp_left) memset(sp_line, 0, 8);
+
+        uint8_t palette[0x20] = {0};
+        if(!is_skipping_pixels)
+        {
+            for(unsigned int i = 0; i < 0x20; ++i)
+                palette[i] = get_pixel_value(pram_access(i)) & color_mask;
+        }
+
+        uint8_t colors[width_px];
+        if(compose_scanln(bg_px, sp_line, palette, colors))
+            stat_sp_zero_hit = true;
+        if(is_skipping_pixels)
+            return;
+
+        uint16_t* pixels = shared_bus.framebuf.append(width_px);
+        uint16_t emphasis = get_pixel_value(0) & ~color_mask;
+        for(unsigned int x = 0; x < width_px; ++x)
+            pixels[x] = (colors[x] | emphasis);
+
+    }
+
+    // Equivalent to execute_cycle() over dots 1-256 of a visible scanline
+    // with rendering enabled, with the background and sprites each composed
+    // a scanline at a time rather than through shift registers and per-dot
+    // priority checks; cartridge reads occur in the same order
+    // Precondition: can_render_scanln_fast()
+    void render_scanln_fast()
+    {
+        // Background, as a stream of pixels (palette << 2 | color) indexed by
+        // dot - 1 + scroll_x_fine: the two tiles in the shift registers
+        // (prefetched on the previous scanline), then 32 tiles fetched here,
+        // each reloaded into the shift registers 8 dots after its fetch begins
+        constexpr unsigned int tile_num = scanln_tile_num;
+        Chr_Row tile_rows[tile_num];
+        uint8_t tile_palette[tile_num];
+        tile_rows[0] = decode_chr_row(bg_tile_shift_lo >> 8, 
+                                      bg_tile_shift_hi >> 8);
+        tile_rows[1] = decode_chr_row(bg_tile_shift_lo, bg_tile_shift_hi);
+        tile_palette[1] = bg_palette_latch;
+        for(unsigned int t = 2; t < tile_num; ++t)
+        {
+            fetch_bg_nt_byte();
+            fetch_bg_attr_byte();
+            tile_rows[t] = fetch_bg_tile_row();
+            tile_palette[t] = next_bg_palette;
+
+            increment_scroll_x_coarse();
+        }
+        increment_scroll_y();
+
+        if(!is_skipping_pixels || may_hit_sprite_zero())
+            output_scanln(tile_rows, tile_palette);
+
+        // Sprite shift registers after the scanline's shifts (slot i starts
+        // shifting sp_xpos[i] dots into the scanline)
+        for(unsigned int i = 0; i < 8; ++i)
+        {
+            bool flip_hori = (sp_attr[i] & (1U << 6));
+            unsigned int shift_num = width_px - sp_xpos[i];
+            auto shift = [flip_hori, shift_num](uint8_t& reg) -> void
+            { 
+                reg = ((shift_num >= 8) ? 0 
+                       : (flip_hori ? (reg >> shift_num) : (reg << shift_num)));
+            };
+            shift(sp_tile_shift_lo[i]);
+            shift(sp_tile_shift_hi[i]);
+            sp_xpos[i] = 0;
+        }
+
+        // State after the scanline's shifts
+        const Chr_Row& high_tile = tile_rows[tile_num - 2];
+        const Chr_Row& low_tile  = tile_rows[tile_num - 1];
+        next_bg_tile_lo = encode_chr_plane(low_tile, 0);
+        next_bg_tile_hi = encode_chr_plane(low_tile, 1);
+        bg_tile_shift_lo = ((encode_chr_plane(high_tile, 0) << 8) | 
+                            next_bg_tile_lo);
+        bg_tile_shift_hi = ((encode_chr_plane(high_tile, 1) << 8) | 
+                            next_bg_tile_hi);
+        palette_shift_lo = ((tile_palette[tile_num - 2] >> 0) & 1U) ? 0xFF : 0;
+        palette_shift_hi = ((tile_palette[tile_num - 2] >> 1) & 1U) ? 0xFF : 0;
+        bg_palette_latch = tile_palette[tile_num - 1];
+
+        // Secondary OAM clear and sprite evaluation, which only depend on
+        // (primary and secondary) OAM
+        if(!evaluate_sprites_fast())
+        {
+            for(dot_count = 1; dot_count <= width_px; ++dot_count)
+            {
+                if(dot_count <= 64) clear_oam_aux();
+                else                perform_sprite_evaluation();
+            }
+        }
+
+        dot_count = width_px + 1;
+        cycle_count += width_px;
+        shared_bus.cycle_count += 4 * width_px;
+        ++fast_scanln_count;
+    }
+
+    // Number of upcoming cycles in which execute_cycle() would do nothing but
+    // advance the cycle count (idle post-render and vertical blank scanlines)
+    uint32_t idle_cycles_ahead()
+    {
+        constexpr uint32_t post_render = height_px * scanln_width;
+        constexpr uint32_t vblank      = (height_px + 1) * scanln_width;
+        constexpr uint32_t pre_render  = (scanln_height - 1) * scanln_width;
+
+        if(!is_nmi_settled())
+            return 0;
+
+        if((cycle_count > vblank) && (cycle_count < pre_render))
+            return (pre_render - cycle_count);
+        else if((cycle_count > post_render) && (cycle_count < vblank))
+            return (vblank - cycle_count);
+        else
+            return 0;
+    }
+
     bool is_warming_up()
     {
         unsigned int cpu_warmup_cycles = 29658;
@@ -580,126 +1032,96 @@ class PPU
     }
 
   public:
-    PPU(Shared_Bus& shared_bus, Cartridge& cart) 
+    Basic_PPU(Shared_Bus& shared_bus, Cart& cart) 
         : shared_bus(shared_bus), cart(cart)
     {
+        cart.ppu_map_pages(shared_bus);
         reset_state(true);
     }
 
-    // Update APU status at start of every scanline?
-    void execute_cycle()
+    // Whether the pixels of the current scanline can still cause a sprite 0
+    // hit, which must be determined even while skipping pixel generation
+    bool may_hit_sprite_zero()
     {
-        stat_nmi_occurred = new_nmi_occurred;
+        return (sprite_zero_on_scanline && !stat_sp_zero_hit);
+    }
 
-        if(is_render_scanln())
+    void output_pixel()
+    {
+        if(is_skipping_pixels)
         {
-            bool is_visible_scanln = (scanln() < height_px);
-
-            if(dot() == 0) 
-            { 
-                if(!is_visible_scanln)
-                {
-                    stat_sp_overflow = false;
-                    stat_sp_zero_hit = false;
-                    new_nmi_occurred = false;
-                    even_odd_frame = !even_odd_frame;
-
-                    if(is_rendering_enabled() && (oam_addr > 0x8))
-                    {
-                        uint8_t mask = (0xFFU << 3);
-                        for(unsigned int i = 0; i < 8; ++i)
-                        {
-                            uint8_t data = read_oam((oam_addr & mask) + i);
-                            write_oam(i, data);
-                        }
-                    }
-                }
-            }
-            else if(dot() <= width_px)
-            {
-                if(is_rendering_enabled())
-                {
-                    fetch_bg_tile_data();
+            if(may_hit_sprite_zero()) get_pixel_color();
+            return;
+        }
 
-                    if(dot() % 8 == 0)          increment_scroll_x_coarse();
-                    if(dot() == width_px)       increment_scroll_y();
+        uint8_t color_index = (((vram_addr % 0x4000 < 0x3F00) || 
+                                is_rendering_enabled())
+            ? get_pixel_color()
+            : vram_addr);
+        shared_bus.framebuf.push(get_pixel_value(pram_access(color_index)));
+    }
 
-                    if(dot() <= 64)             clear_oam_aux();
-                    else if(is_visible_scanln)  perform_sprite_evaluation();
-                }
+    void start_frame()
+    {
+        stat_sp_overflow = false;
+        stat_sp_zero_hit = false;
+        new_nmi_occurred = false;
+        even_odd_frame = !even_odd_frame;
+        is_skipping_pixels = shared_bus.should_skip_frame();
 
-                if(is_visible_scanln)
-                {
-                    uint8_t color_index = (((vram_addr % 0x4000 < 0x3F00) || 
-                                            is_rendering_enabled())
-                        ? get_pixel_color()
-                        : vram_addr);
-                    uint8_t px_color = pram_access(color_index) & (0xFFU >> 2);
-                    shared_bus.framebuf.push(px_color);
-                }
-                    
-                shift_bg_registers();
-                shift_sp_registers();
-            }
-            else if(dot() <= hblank_end)
+        if(is_rendering_enabled() && (oam_addr > 0x8))
+        {
+            uint8_t mask = (0xFFU << 3);
+            for(unsigned int i = 0; i < 8; ++i)
             {
-                if(is_rendering_enabled())
-                {
-                    if(dot() == width_px + 1) reload_scroll_x_coarse();
-                    
-                    oam_addr = 0;
-
-                    fetch_bg_tile_data();
-                    fetch_sp_tile_data();
-                    
-                    if((dot() >= 280) && (dot() <= 304))
-                    {
-                        if(!is_visible_scanln) reload_scroll_y();
-                    }
-                }
+                uint8_t data = read_oam((oam_addr & mask) + i);
+                write_oam(i, data);
             }
-            else if(dot() < (scanln_width - 4))
-            {
-                if(is_rendering_enabled())
-                {
-                    fetch_bg_tile_data();
+        }
+    }
 
-                    if(dot() == hblank_end + 1) oam_buf = read_oam_aux(0);
-                    if(dot() % 8 == 0) increment_scroll_x_coarse();
-                }
+    // Update APU status at start of every scanline?
+    void execute_cycle()
+    {
+        using namespace Dot_Action;
 
-                shift_bg_registers();
-            }
-            else
-            {
-                if(is_rendering_enabled()) 
-                {
-                    if(dot() % 2) cart_read(nt_addr());
+        stat_nmi_occurred = new_nmi_occurred;
 
-                    if(dot() == scanln_width - 3)
-                    {
-                        if(!is_visible_scanln && even_odd_frame) 
-                        {
-                            increment_cycle_count();
-                        }
-                    }
-                }
-            }
-        }
-        else if(scanln() == height_px)
+        uint32_t actions = dot_action_table.actions[scanln_type][dot_count];
+        if(!is_rendering_enabled()) 
+            actions &= ~RENDERING_ONLY;
+
+        if(actions)
         {
-            if(dot() == 0) 
+            if(actions & FRAME_START)       start_frame();
+            if(actions & FRAME_END)
             {
                 set_vram_addr_bus(vram_addr);
-                
-                shared_bus.push_frame();
+                shared_bus.push_frame(!is_skipping_pixels);
             }
-            else { /* Idle */ }
-        }
-        else if(scanln() == height_px + 1)
-        {
-            if(dot() == 0) new_nmi_occurred = true;
-            else           { /* Idle */ }
+            if(actions & VBLANK_SET)        new_nmi_occurred = true;
+
+            if(actions & SCROLL_X_RELOAD)   reload_scroll_x_coarse();
+            if(actions & OAM_ADDR_RESET)    oam_addr = 0;
+            if(actions & BG_FETCH_NT)       fetch_bg_nt_byte();
+            if(actions & BG_FETCH_ATTR)     fetch_bg_attr_byte();
+            if(actions & BG_FETCH_LO)       fetch_bg_tile_lo();
+            if(actions & BG_FETCH_HI)       fetch_bg_tile_hi();
+            if(actions & SP_FETCH)          fetch_sp_tile_data();
+            if(actions & SCROLL_Y_RELOAD)   reload_scroll_y();
+            if(actions & OAM_AUX_LATCH)     oam_buf = read_oam_aux(0);
+            if(actions & SCROLL_X_INC)      increment_scroll_x_coarse();
+            if(actions & SCROLL_Y_INC)      increment_scroll_y();
+            if(actions & OAM_AUX_CLEAR)     clear_oam_aux();
+            if(actions & SP_EVAL)           perform_sprite_evaluation();
+            if(actions & NT_DUMMY_FETCH)    cart_read(nt_addr());
+            if((actions & ODD_FRAME_SKIP) && even_odd_frame)
+                increment_cycle_count();
+
+            if(actions & PIXEL_OUTPUT)      output_pixel();
+            if(actions & BG_SHIFT)          shift_bg_registers();
+            if(actions & BG_RELOAD)         reload_bg_registers();
+            if(actions & SP_SHIFT)          shift_sp_registers();
         }
 
         increment_cycle_count();
@@ -707,12 +1129,90 @@ class PPU
         shared_bus.line_nmi_low = (ctrl_nmi_output && stat_nmi_occurred);
     }
 
-    
+
+    // Lower bound on the number of cycles that can be executed before the PPU
+    // changes state visible to the CPU without a register access (the NMI line
+    // or the frame buffers); the CPU may defer execution until then
+    uint32_t cycles_until_event()
+    {
+        constexpr uint32_t frame_len = scanln_width * scanln_height;
+        constexpr uint32_t events[] =
+        {
+            (height_px + 0) * scanln_width,         // Frame push
+            (height_px + 1) * scanln_width,         // NMI occurred set
+            (scanln_height - 1) * scanln_width      // NMI occurred cleared
+        };
+
+        if(!is_nmi_settled())
+            return 1;
+
+        uint32_t min_dist = frame_len;
+        for(uint32_t event : events)
+        {
+            uint32_t dist = (event + frame_len - cycle_count) % frame_len;
+            if(dist < min_dist) min_dist = dist;
+        }
+
+        // The event cycle is executed after (dist + 1) cycles, or after
+        // (dist) cycles if the odd frame's idle cycle is skipped on the way
+        return ((min_dist > 1) ? min_dist : 1);
+    }
+
+    // Whether rendering leaves OAM alone during the given number of upcoming
+    // cycles (i.e. OAM may then be written to at any point within them)
+    bool is_oam_idle(uint32_t cycles)
+    {
+        constexpr uint32_t post_render = height_px * scanln_width;
+        constexpr uint32_t pre_render  = (scanln_height - 1) * scanln_width;
+
+        return (!is_rendering_enabled() ||
+                ((cycle_count >= post_render) &&
+                 (cycle_count + cycles <= pre_render)));
+    }
+
+    // Equivalent to calling execute_cycle() the given number of times
+    void catch_up(uint32_t cycles)
+    {
+        while(cycles > 0)
+        {
+            uint32_t idle = idle_cycles_ahead();
+            if(idle > 0)
+            {
+                if(idle > cycles) idle = cycles;
+                set_cycle_count(cycle_count + idle);
+                shared_bus.cycle_count += 4 * idle;
+                cycles -= idle;
+            }
+            else if(can_render_scanln_fast(cycles))
+            {
+                render_scanln_fast();
+                cycles -= width_px;
+            }
+            else
+            {
+                execute_cycle();
+                --cycles;
+            }
+        }
+    }
+
+    // Number of visible scanlines rendered, in total and by
+    // render_scanln_fast() (the rest taking a dot at a time)
+    uint64_t get_scanln_count()      { return visible_scanln_count; }
+    uint64_t get_fast_scanln_count() { return fast_scanln_count; }
+
+    // Bit 7 of $2002, without the side effects of reading it
+    bool is_vblank_flag_set() { return stat_nmi_occurred; }
+
     uint8_t read_reg(uint8_t reg_index)
     {
         uint8_t mask = 0x00;
         uint8_t value = 0x00;
 
+        // Other reads leave everything but the latch alone
+        if((reg_index == 0x2) || (reg_index == 0x7))
+            shared_bus.log_ppu_input(Ppu_Input::READ, 0x2000 | reg_index, 0);
+
         switch(reg_index)
         {
             case(0x2):
@@ -753,6 +1253,7 @@ class PPU
     
     void write_reg(uint8_t reg_index, uint8_t data)
     {
+        shared_bus.log_ppu_input(Ppu_Input::WRITE, 0x2000 | reg_index, data);
         reg_latch = data;
 
         switch(reg_index)
@@ -781,7 +1282,6 @@ class PPU
                 mask_emph_r             = ((data >> 5) & 1U);
                 mask_emph_g             = ((data >> 6) & 1U);
                 mask_emph_b             = ((data >> 7) & 1U);
-                //TODO implement color emphasis/grayscale
                 break;
             }
             case(0x3):
@@ -857,8 +1357,8 @@ class PPU
         }
     }
     
-    uint16_t dot()    { return cycle_count % scanln_width; }
-    uint16_t scanln() { return cycle_count / scanln_width; }
+    uint16_t dot()    { return dot_count; }
+    uint16_t scanln() { return scanln_count; }
 
     void reset_state(bool is_power_cycle)
     {
@@ -888,7 +1388,7 @@ class PPU
         vram_read_buf = 0;
         even_odd_frame = true;
 
-        cycle_count = 0;
+        set_cycle_count(0);
         //frame_count = 0;
         
         // OAM unspecified
@@ -908,6 +1408,8 @@ class PPU
     }
 };
 
+using PPU = Basic_PPU<Cartridge>;
+
 
 }
 #endif // PPU_H_NOS
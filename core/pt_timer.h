@@ -10,9 +10,11 @@ namespace NES
 // For use with Pulse and Triangle channels
 struct PT_Timer
 {
-    uint16_t clock_reload;
+    uint16_t clock_reload = 0;
     uint16_t clock : 11;
 
+    PT_Timer() : clock(0) {}
+
     void write_c(uint8_t data)
     {
         clock_reload &= 0xFF00U;
@@ -42,6 +44,23 @@ struct PT_Timer
 
         return pulse_seq;
     }
+
+    // Equivalent to calling pulse_clock() num times; returns the number of
+    // pulses
+    uint32_t advance(uint32_t num)
+    {
+        if(num <= clock)
+        {
+            clock -= num;
+            return 0;
+        }
+
+        // The first pulse, then one every (clock_reload + 1) clocks
+        num -= (clock + 1);
+        uint32_t period = uint32_t(clock_reload) + 1;
+        clock = clock_reload - (num % period);
+        return (1 + (num / period));
+    }
 };
 
 
@@ -31,7 +31,8 @@ struct Pulse
     uint8_t duty_index : 2;
 
     Pulse(bool fst_snd) 
-        : envel(lectr.halt), sweep(timer.clock_reload, fst_snd) 
+        : envel(lectr.halt), sweep(timer.clock_reload, fst_snd), seq(0),
+          duty_index(0)
     {
     }
 
@@ -71,6 +72,22 @@ struct Pulse
         if(pulse_seq) --seq;
     }
 
+    // Equivalent to calling tick() the given number of times
+    void advance(uint32_t ticks)
+    {
+        uint32_t steps = timer.advance(ticks);
+        seq = seq - (steps % 8);
+    }
+
+    // Number of tick()s until vol() may next change (barring frame sequencer
+    // steps and register writes); 0 if it cannot
+    uint32_t ticks_until_change()
+    {
+        bool is_silent = (!sweep.is_audible() || !lectr.is_active() ||
+                          (envel.vol() == 0));
+        return (is_silent ? 0 : timer.clock + 1);
+    }
+
     void tick_frame_quarter()
     {
         envel.tick_frame_quarter();
@@ -0,0 +1,110 @@
+#ifndef  RATE_CONTROL_H_NOS
+#define  RATE_CONTROL_H_NOS
+
+#include <algorithm>    // min, max, clamp
+#include <cstdint>      // uint64_t
+#include <cstddef>      // size_t
+
+namespace NES
+{
+
+
+// Dynamic rate control for streamed audio: when emulation is paced by some
+// clock other than the audio device's (e.g. vsync), samples are produced
+// slightly faster or slower than the device plays them, so that the buffer
+// between them would eventually underrun or build up latency. Given the
+// buffer's fill level once per frame, update() returns the ratio by which to
+// scale the sample rate (see Console_Base::set_audio_rate_ratio()), by up to
+// max_deviation according to how far the (smoothed) fill level is and has
+// been from target_fill, steering it back without audible pitch changes.
+// Emulation should still wait for the device while the buffer holds
+// max_fill_allowed or more (is_ahead()): when nothing else paces emulation
+// (or the other clock runs fast), the audio device's clock then does,
+// bounding the latency
+class Rate_Control
+{
+  private:
+    size_t target_fill;
+    size_t max_fill_allowed;
+    double max_deviation;
+
+    // Exponential moving average of the fill level, over about 16 updates
+    double smoothed_fill;
+
+    // Accumulated error (relative to target_fill), which settles at whatever
+    // offset the two clocks need, so that the fill level itself settles at
+    // target_fill rather than short of it
+    double error_sum = 0;
+
+    // Telemetry since the last reset_telemetry()
+    size_t fill = 0;
+    size_t min_fill = 0;
+    size_t max_fill = 0;
+    double ratio = 1;
+    double min_ratio = 1;
+    double max_ratio = 1;
+    uint64_t update_num = 0;
+    uint64_t wait_num = 0;
+
+  public:
+    // Precondition: 0 < target_fill <= max_fill_allowed
+    Rate_Control(size_t target_fill, size_t max_fill_allowed,
+                 double max_deviation = 0.005)
+        : target_fill(target_fill), max_fill_allowed(max_fill_allowed),
+          max_deviation(max_deviation), smoothed_fill(target_fill) {}
+
+    double update(size_t new_fill)
+    {
+        constexpr double smoothing = 1.0 / 16;
+        smoothed_fill += (new_fill - smoothed_fill) * smoothing;
+
+        constexpr double integral_gain = 1.0 / 1024;
+        double error = (target_fill - smoothed_fill) / target_fill;
+        error_sum = std::clamp(error_sum + (error * integral_gain), -1.0, 1.0);
+        ratio = 1 + (max_deviation * std::clamp(error + error_sum, -1.0, 1.0));
+
+        fill = new_fill;
+        min_fill  = ((update_num > 0) ? std::min(min_fill, fill) : fill);
+        max_fill  = ((update_num > 0) ? std::max(max_fill, fill) : fill);
+        min_ratio = ((update_num > 0) ? std::min(min_ratio, ratio) : ratio);
+        max_ratio = ((update_num > 0) ? std::max(max_ratio, ratio) : ratio);
+        ++update_num;
+
+        return ratio;
+    }
+
+    // Whether emulation should wait for the device to play some samples
+    bool is_ahead(size_t current_fill)
+    {
+        bool is_ahead = (current_fill >= max_fill_allowed);
+        if(is_ahead) ++wait_num;
+        return is_ahead;
+    }
+
+    size_t get_target_fill() const { return target_fill; }
+    size_t get_max_fill_allowed() const { return max_fill_allowed; }
+    double get_smoothed_fill() const { return smoothed_fill; }
+
+    // Fill levels passed to update(), and the ratios it returned
+    size_t get_fill() const { return fill; }
+    size_t get_min_fill() const { return min_fill; }
+    size_t get_max_fill() const { return max_fill; }
+    double get_ratio() const { return ratio; }
+    double get_min_ratio() const { return min_ratio; }
+    double get_max_ratio() const { return max_ratio; }
+    uint64_t get_update_num() const { return update_num; }
+
+    // Calls to is_ahead() which returned true
+    uint64_t get_wait_num() const { return wait_num; }
+
+    void reset_telemetry()
+    {
+        update_num = 0;
+        wait_num = 0;
+    }
+};
+
+
+}
+
+#endif //RATE_CONTROL_H_NOS
@@ -1,10 +1,15 @@
 #ifndef  SHARED_BUS_H_NOS
 #define  SHARED_BUS_H_NOS
 
+#include <algorithm>    // min
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
+#include <cstring>      // memcpy
 #include <vector>
 
+#include "chr_cache.h"
+
 using std::vector;
 
 namespace NES
@@ -21,9 +26,21 @@ enum : unsigned int
     pixel_quantity = width_px * height_px,
     ppu_ticks_per_cpu = 3,
     // Note: 3 PPU cycles per CPU cycle
-    max_samples_per_frame = ((scanln_width * scanln_height) / 3) + 1
+    default_sample_rate = 44100,
+    max_sample_rate = 96000,
+    // A frame lasts slightly less than 1/60 s, and the sample rate may be
+    // scaled by up to 1% (see Console_Base::set_audio_rate_ratio())
+    max_samples_per_frame = (((max_sample_rate / 60) * 101) / 100) + 1
 };
 
+static constexpr double clock_speed_hz = (1000 * 1000) * (236.25 / 11);
+static constexpr double cpu_clock_speed_hz = clock_speed_hz / 12;
+
+// About 60.0988 Hz, as every other frame is a dot shorter while rendering
+static constexpr double frame_rate_hz = 
+    (cpu_clock_speed_hz * ppu_ticks_per_cpu) / 
+    ((scanln_width * scanln_height) - 0.5);
+
 namespace IRQ_Src
 {
     enum : unsigned int
@@ -33,35 +50,239 @@ namespace IRQ_Src
     };
 }
 
+// How often the APU hands its samples over (see Console_Base)
+enum class Audio_Delivery
+{
+    FRAME,          // As a block per frame, through Shared_Bus::audiobuf
+    SCANLINE,       // Into Shared_Bus::audio_ring, every scanline's duration
+    SAMPLES         // Likewise, every given number of samples
+};
+
+// A CPU access which affects what the PPU outputs (see Deferred_Renderer),
+// stamped with the Shared_Bus cycle count at which it took place
+struct Ppu_Input
+{
+    enum : uint8_t
+    {
+        READ,           // PPU register ($2002, $2007)
+        WRITE,          // PPU register or cartridge space
+        FRAME_SKIP      // Decision of should_skip_frame(), as data
+    };
+
+    uint64_t cycle;
+    uint16_t addr;
+    uint8_t  data;
+    uint8_t  type;
+};
+
 class Shared_Bus
 {
   private:
     uint64_t frame_count = 0;
 
   public:
+    // Single-producer single-consumer handoff of blocks of N elements (e.g.
+    // frames) without copying or locking: the producer fills the back slot
+    // and publishes it, the consumer acquires the latest published slot as
+    // its front, and the third slot sits between them. The producer and the
+    // consumer may run on different threads; a front slot stays untouched
+    // until the consumer acquires again.
     template<class T, size_t N>
-    class Double_Buffer
+    class Triple_Buffer
     {
       private:
+        enum : uint8_t { IS_FRESH = 1U << 2 };  // Flag of middle
+
+        T storage[3][N] = {};
+        T* slots[3] = { storage[0], storage[1], storage[2] };
+        size_t sizes[3] = { 0, 0, 0 };
+
+        // Slot indices; middle has IS_FRESH set while it holds a block
+        // published since the consumer's last acquire()
+        uint8_t back_slot  = 0;
+        uint8_t front_slot = 1;
+        std::atomic<uint8_t> middle{2};
+
+        T* back = storage[0];
         size_t index = 0;
-        bool toggle = false;
-        T fst[N] = { 0 };
-        T snd[N] = { 0 };
-        T        (&back())[N] { return (toggle ? fst : snd); }
 
       public:
-        const T (&front())[N] { return (toggle ? snd : fst); }
-        void push(T val) { back()[index++] = val; }
-        void swap() { toggle = !toggle; index = 0; }
-        Double_Buffer() {}
+        // Producer side
+        void push(T val) { back[index++] = val; }
+        void push(const T* vals, size_t num)
+        {
+            std::memcpy(back + index, vals, num * sizeof(T));
+            index += num;
+        }
+        // Space for the next num elements, to be written in place
+        T* append(size_t num)
+        {
+            T* dst = back + index;
+            index += num;
+            return dst;
+        }
+        void publish()
+        {
+            sizes[back_slot] = index;
+            uint8_t prev = middle.exchange(back_slot | IS_FRESH, 
+                                           std::memory_order_acq_rel);
+            back_slot = (prev & ~IS_FRESH);
+            back = slots[back_slot];
+            index = 0;
+        }
+        // Drops the elements pushed since the last publish()
+        void discard() { index = 0; }
+
+        // Consumer side; returns whether a newer block was acquired
+        bool acquire()
+        {
+            if(!(middle.load(std::memory_order_relaxed) & IS_FRESH))
+                return false;
+            uint8_t prev = middle.exchange(front_slot, 
+                                           std::memory_order_acq_rel);
+            front_slot = (prev & ~IS_FRESH);
+            return true;
+        }
+        const T (&front())[N] 
+        { 
+            return *reinterpret_cast<const T(*)[N]>(slots[front_slot]);
+        }
+        // Number of elements pushed into the front block
+        size_t front_size() { return sizes[front_slot]; }
+
+        // Replaces the internal storage with caller-owned memory of N
+        // elements per slot (e.g. a shared memory segment read by another
+        // process), so that blocks are produced directly in their final
+        // destination; whichever slot the consumer has acquired stays
+        // untouched, as with the internal storage
+        // Precondition: neither side is active
+        void set_destinations(T* fst, T* snd, T* trd)
+        {
+            T* dsts[3] = { fst, snd, trd };
+            for(unsigned int i = 0; i < 3; ++i)
+                slots[i] = dsts[i];
+            back = slots[back_slot];
+        }
+
+        Triple_Buffer() {}
+    };
+
+
+    // Single-producer single-consumer FIFO of samples, streamed without
+    // locking: the producer pushes samples as they are synthesized, and the
+    // consumer (e.g. an audio callback on another thread) pops them as it
+    // needs them. Samples which don't fit are dropped, and samples popped
+    // before being pushed are starved (left to the consumer to fill in); the
+    // fill level and both counts may be read from either side
+    class Sample_Ring
+    {
+      public:
+        enum : size_t { capacity = 1U << 13 };  // Power of 2
+
+      private:
+        float samples[capacity];
+
+        // Samples pushed/popped so far, each only written by its own side
+        // (and kept on separate cache lines, as are the counts)
+        alignas(64) std::atomic<uint64_t> push_count{0};
+                    std::atomic<uint64_t> dropped_num{0};
+        alignas(64) std::atomic<uint64_t> pop_count{0};
+                    std::atomic<uint64_t> starved_num{0};
+
+      public:
+        // Producer side; returns the number of samples which fit
+        size_t push(const float* src, size_t num)
+        {
+            uint64_t pushed = push_count.load(std::memory_order_relaxed);
+            uint64_t popped = pop_count.load(std::memory_order_acquire);
+            size_t fit = std::min<size_t>(num, capacity - (pushed - popped));
+
+            size_t start = pushed % capacity;
+            size_t fst = std::min<size_t>(fit, capacity - start);
+            std::memcpy(samples + start, src, fst * sizeof(float));
+            std::memcpy(samples, src + fst, (fit - fst) * sizeof(float));
+            push_count.store(pushed + fit, std::memory_order_release);
+
+            if(fit < num)
+                dropped_num.fetch_add(num - fit, std::memory_order_relaxed);
+            return fit;
+        }
+
+        // Consumer side; returns the number of samples available
+        size_t pop(float* dst, size_t num)
+        {
+            uint64_t popped = pop_count.load(std::memory_order_relaxed);
+            uint64_t pushed = push_count.load(std::memory_order_acquire);
+            size_t got = std::min<size_t>(num, pushed - popped);
+
+            size_t start = popped % capacity;
+            size_t fst = std::min<size_t>(got, capacity - start);
+            std::memcpy(dst, samples + start, fst * sizeof(float));
+            std::memcpy(dst + fst, samples, (got - fst) * sizeof(float));
+            pop_count.store(popped + got, std::memory_order_release);
+
+            if(got < num)
+                starved_num.fetch_add(num - got, std::memory_order_relaxed);
+            return got;
+        }
+
+        // Samples pushed but not popped yet
+        size_t size() const
+        {
+            // Popped first, as it never overtakes pushed
+            uint64_t popped = pop_count.load(std::memory_order_acquire);
+            uint64_t pushed = push_count.load(std::memory_order_acquire);
+            return (pushed - popped);
+        }
+
+        uint64_t get_dropped_num() const { return dropped_num.load(); }
+        uint64_t get_starved_num() const { return starved_num.load(); }
+
+        Sample_Ring() {}
     };
 
 
-    Double_Buffer<uint8_t, pixel_quantity>      framebuf;
-    Double_Buffer<float, max_samples_per_frame> audiobuf;
+    // Pixel values as described in palette.h, and samples at the APU's
+    // sample rate (a varying number per frame)
+    Triple_Buffer<uint16_t, pixel_quantity>     framebuf;
+    Triple_Buffer<float, max_samples_per_frame> audiobuf;
+
+    // Samples streamed while the APU's delivery isn't Audio_Delivery::FRAME
+    Sample_Ring audio_ring;
 
     uint8_t ciram[0x800] = {0};
 
+    // CPU address space split into 256-byte pages for direct access to plain
+    // memory (RAM, mapped PRG banks); a null entry defers to the read/write
+    // handler of whichever component the address belongs to. Pages mapped
+    // without a write pointer are expected to be immutable (i.e. ROM)
+    const uint8_t* cpu_page_read [0x100] = {nullptr};
+          uint8_t* cpu_page_write[0x100] = {nullptr};
+
+    // Precondition: first_page + page_num <= 0x100
+    void map_cpu_pages(uint8_t first_page, unsigned int page_num,
+                       const uint8_t* read, uint8_t* write)
+    {
+        for(unsigned int i = 0; i < page_num; ++i)
+        {
+            cpu_page_read [first_page + i] = (read  ? read  + (i << 8) : nullptr);
+            cpu_page_write[first_page + i] = (write ? write + (i << 8) : nullptr);
+        }
+        ++cpu_map_generation;
+    }
+
+    // Incremented on every change to the page map
+    uint32_t cpu_map_generation = 0;
+
+    // PPU address space ($0000-$3FFF) split into 1KB pages likewise, the
+    // pattern table pages also with their rows decoded (see Chr_Cache); a
+    // null entry defers to the cartridge's ppu_read()/ppu_write() (e.g. for
+    // mappers which watch pattern table reads). $3F00-$3FFF is never looked
+    // up here (palette RAM)
+    const uint8_t* ppu_page_read [0x10] = {nullptr};
+          uint8_t* ppu_page_write[0x10] = {nullptr};
+    const Chr_Row* ppu_row_page  [0x8]  = {nullptr};
+
     uint16_t line_irq_low = 0;
     bool     line_nmi_low = false;
 
@@ -69,12 +290,48 @@ class Shared_Bus
 
     uint64_t cycle_count = 0;
 
-    void push_frame()
+    // Pixel generation is skipped for frame_skip_num out of every
+    // frame_skip_period frames, and for the next frame to start once
+    // is_frame_skip_requested is set
+    unsigned int frame_skip_num    = 0;
+    unsigned int frame_skip_period = 1;
+    bool is_frame_skip_requested = false;
+
+    // While set, every Ppu_Input is appended to it; pixel generation is then
+    // left to whoever replays the log, to which frame skip decisions pass
+    vector<Ppu_Input>* ppu_input_log = nullptr;
+
+    void log_ppu_input(uint8_t type, uint16_t addr, uint8_t data)
+    {
+        if(ppu_input_log)
+            ppu_input_log->push_back({ cycle_count, addr, data, type });
+    }
+
+    // To be invoked as each frame starts
+    bool should_skip_frame()
+    {
+        bool should_skip = (is_frame_skip_requested || 
+                            ((frame_count % frame_skip_period) < 
+                             frame_skip_num));
+        is_frame_skip_requested = false;
+
+        if(ppu_input_log)
+        {
+            log_ppu_input(Ppu_Input::FRAME_SKIP, 0, should_skip);
+            return true;
+        }
+        return should_skip;
+    }
+
+    // A frame whose pixels were skipped leaves the last full frame published;
+    // the APU publishes the frame's audio once it notices (see
+    // APU::end_frame()), if delivering it per frame
+    void push_frame(bool has_pixels)
     {
         ++frame_count;
 
-        framebuf.swap();
-        audiobuf.swap();
+        if(has_pixels) framebuf.publish();
+        else           framebuf.discard();
     }
 
     uint64_t get_frame_count() { return frame_count; }
@@ -9,14 +9,14 @@ namespace NES
 struct Sweep
 {
     bool pulse_fst_snd;
-    bool should_reload;
-    bool enabled;
-    bool negate;
+    bool should_reload = false;
+    bool enabled = false;
+    bool negate = false;
     uint8_t div_ctr : 3;
     uint8_t div_reload : 3;
     uint8_t shamt : 3;
     uint16_t target_reload : 11;
-    bool sweep_overflow;
+    bool sweep_overflow = false;
     uint16_t& timer_clock_reload;
 
     // Invoke any time target_reload might change value
@@ -35,7 +35,8 @@ struct Sweep
     }
 
     Sweep(uint16_t& timer_clock_reload, bool pulse_fst_snd) 
-        : timer_clock_reload(timer_clock_reload), pulse_fst_snd(pulse_fst_snd) 
+        : pulse_fst_snd(pulse_fst_snd), div_ctr(0), div_reload(0), shamt(0),
+          target_reload(0), timer_clock_reload(timer_clock_reload)
     {
     }
 
@@ -21,7 +21,7 @@ class Triangle
     uint8_t seq : 5;
 
   public:
-    Triangle() : lictr(lectr.halt) {}
+    Triangle() : lictr(lectr.halt), seq(0) {}
 
     void set_enabled(bool val) { lectr.set_enabled(val); }
     bool is_active() { return lectr.is_active(); }
@@ -54,6 +54,19 @@ class Triangle
         if(pulse_seq && lectr.is_active() && lictr.is_active()) ++seq;
     }
 
+    // As Pulse::advance() and Pulse::ticks_until_change()
+    void advance(uint32_t ticks)
+    {
+        uint32_t steps = timer.advance(ticks);
+        if(lectr.is_active() && lictr.is_active()) seq = seq + (steps % 32);
+    }
+
+    uint32_t ticks_until_change()
+    {
+        bool is_halted = (!lectr.is_active() || !lictr.is_active());
+        return (is_halted ? 0 : timer.clock + 1);
+    }
+
     void tick_frame_quarter()
     {
         lictr.tick_frame_quarter();
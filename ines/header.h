@@ -2,8 +2,11 @@
 #define  HEADER_H_NOS
 
 #include <array>
+#include <memory>
 #include <vector>
 
+#include "chr_cache.h"
+
 enum : unsigned int
 {
     prg_block_size_exp = 14,
@@ -21,6 +24,10 @@ struct Header
 
     std::vector<std::array<uint8_t, prg_block_size>> prg;
     std::vector<std::array<uint8_t, chr_block_size>> chr;
+
+    // Decoded form of chr (see NES::Chr_Cache), moved into the mapper built
+    // from this header, so as not to hold a reference of its own
+    std::shared_ptr<NES::Chr_Cache> chr_cache;
 };
 
 #endif //HEADER_H_NOS
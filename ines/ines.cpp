@@ -1,18 +1,25 @@
 #include <array>
 #include <cstdint>      // uint8_t
 #include <stdexcept>    // runtime_error
-#include <memory>       // unique_ptr, make_unique
+#include <memory>       // unique_ptr, make_unique, shared_ptr, weak_ptr
+#include <mutex>
+#include <utility>      // pair
 #include <vector>
 #include <cstring>      // memcpy
 
 #include "cart.h"
+#include "console.h"
 #include "mapper.h"
 #include "mapper00.h"
 
 using std::array;
 using std::runtime_error;
+using std::make_shared;
 using std::make_unique;
+using std::pair;
+using std::shared_ptr;
 using std::unique_ptr;
+using std::weak_ptr;
 using std::vector;
             
 static_assert(sizeof(uint8_t) == 1);
@@ -21,28 +28,67 @@ namespace
 {
 
 
-using Factory = unique_ptr<Mapper>(*)(const Header&);
-
 template<typename M>
 unique_ptr<Mapper> make_mapper(const Header& header)
 {
     return make_unique<M>(header);
 }
 
+template<typename M>
+unique_ptr<NES::Console_Base> make_console(const Header& header)
+{
+#ifdef NOS_STATIC_MAPPERS
+    return make_unique<NES::Basic_Console<M>>(make_unique<M>(header));
+#else
+    return make_unique<NES::Console>(make_mapper<M>(header));
+#endif
+}
+
+struct Factory
+{
+    unique_ptr<Mapper> (*make_mapper)(const Header&);
+    unique_ptr<NES::Console_Base> (*make_console)(const Header&);
+};
+
+template<typename M>
+constexpr Factory factory = { make_mapper<M>, make_console<M> };
+
 Factory get_mapper(uint8_t mapper_id)
 {
     switch(mapper_id)
     {
-        case(0x00): return make_mapper<Mapper00>;
+        case(0x00): return factory<Mapper00>;
 
         default:    throw runtime_error("Mapper not implemented");
     }
 }
 
+// Returns the cache of an identical CHR-ROM loaded earlier, if one is still in
+// use, so that cartridges of the same game (e.g. in several consoles) share it
+shared_ptr<NES::Chr_Cache> share_chr_cache(shared_ptr<NES::Chr_Cache> cache)
+{
+    static std::mutex mutex;
+    static vector<weak_ptr<NES::Chr_Cache>> caches;
 
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto it = caches.begin(); it != caches.end(); )
+    {
+        shared_ptr<NES::Chr_Cache> other = it->lock();
+        if(!other)
+        {
+            it = caches.erase(it);
+            continue;
+        }
+        if(*other == *cache)
+            return other;
+        ++it;
+    }
+
+    caches.push_back(cache);
+    return cache;
 }
 
-unique_ptr<NES::Cartridge> load_ines(const vector<uint8_t>& input)
+pair<uint8_t, Header> parse_ines(const vector<uint8_t>& input)
 {
     static constexpr unsigned int header_size = 0x10;
     
@@ -106,6 +152,11 @@ unique_ptr<NES::Cartridge> load_ines(const vector<uint8_t>& input)
     if(!has_chr_rom)
         chr_rom.resize(1);
 
+    auto chr_cache = make_shared<NES::Chr_Cache>(
+        chr_rom.front().data(), chr_rom.size() * chr_block_size);
+    if(has_chr_rom)
+        chr_cache = share_chr_cache(chr_cache);
+
     Header header = 
     { 
         mirror_vertical, 
@@ -113,9 +164,24 @@ unique_ptr<NES::Cartridge> load_ines(const vector<uint8_t>& input)
         mirror_alt_mode, 
         has_chr_rom, 
         prg_rom, 
-        chr_rom 
+        chr_rom,
+        chr_cache
     };
 
-    Factory make_mapper = get_mapper(mapper_id);
-    return make_mapper(header);
+    return { mapper_id, header };
+}
+
+
+}
+
+unique_ptr<NES::Cartridge> load_ines(const vector<uint8_t>& input)
+{
+    auto [ mapper_id, header ] = parse_ines(input);
+    return get_mapper(mapper_id).make_mapper(header);
+}
+
+unique_ptr<NES::Console_Base> load_ines_console(const vector<uint8_t>& input)
+{
+    auto [ mapper_id, header ] = parse_ines(input);
+    return get_mapper(mapper_id).make_console(header);
 }
@@ -6,9 +6,16 @@
 #include <vector>
 
 #include "cart.h"
+#include "console.h"
 
 
 std::unique_ptr<NES::Cartridge> load_ines(const std::vector<uint8_t>&);
 
+// A console with the cartridge inserted; if NOS_STATIC_MAPPERS is defined,
+// a Basic_Console instantiated for the concrete mapper class, otherwise a
+// (generic) Console
+std::unique_ptr<NES::Console_Base> load_ines_console(
+    const std::vector<uint8_t>&);
+
 
 #endif //INES_H_NOS
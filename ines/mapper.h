@@ -1,17 +1,59 @@
 #ifndef  MAPPER_H_NOS
 #define  MAPPER_H_NOS
 
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <tuple>
+#include <utility>
 
 #include "cart.h"
+#include "chr_cache.h"
 #include "shared_bus.h"
 #include "header.h"
 
+namespace Mirroring
+{
+    enum : uint8_t
+    {
+        HORIZONTAL,
+        VERTICAL,
+        SINGLE_LOWER,
+        SINGLE_UPPER,
+        FOUR_SCREEN,
+        NUM
+    };
+}
+
+// CHR memory is addressed as a whole by offset (see get_chr_offset())
+static_assert(sizeof(std::array<uint8_t, chr_block_size>) == chr_block_size);
+
 class Mapper : public NES::Cartridge
 {
   private:
     Header header;
+    std::shared_ptr<NES::Chr_Cache> chr_cache;
+
+    // Offset into CHR memory of each 1KB pattern table page, and nametable
+    // memory page of each nametable (see set_mirroring()); whoever changes
+    // them must invoke ppu_map_pages() afterwards
+    uint32_t chr_pages[8] = {0};
+    uint8_t  nt_pages[4] = {0};
+
+    // The extra 2KB of nametable memory of four-screen cartridges
+    uint8_t nt_ram[0x800] = {0};
+
+    uint8_t* get_nt_page(NES::Shared_Bus& shared_bus, uint8_t nt)
+    {
+        uint8_t page = nt_pages[nt];
+        return ((page < 2) ? shared_bus.ciram + (page << 10)
+                           : nt_ram + ((page - 2) << 10));
+    }
+
+    size_t get_chr_offset(const uint8_t& chr_byte)
+    {
+        return (&chr_byte - header.chr.front().data());
+    }
 
     static uint32_t get_bank_num(uint8_t block_num, unsigned int bank_size_exp,
         unsigned int block_size_exp)
@@ -53,36 +95,117 @@ class Mapper : public NES::Cartridge
 
     uint8_t& access_prg(uint32_t bank, uint32_t sub_addr)
     {
-        return access_rom(header.prg, bank, get_prg_bank_num(),
-            get_prg_bank_size_exp(), prg_block_size_exp, sub_addr);
+        return access_prg(bank, sub_addr, get_prg_bank_size_exp());
     }
     
     uint8_t& access_chr(uint32_t bank, uint32_t sub_addr)
     {
-        return access_rom(header.chr, bank, get_chr_bank_num(), 
-            get_chr_bank_size_exp(), chr_block_size_exp, sub_addr);
+        return access_chr(bank, sub_addr, get_chr_bank_size_exp());
+    }
+
+    // As above, with the bank size already known (see Mapper_Impl)
+    uint8_t& access_prg(uint32_t bank, uint32_t sub_addr, 
+            unsigned int bank_size_exp)
+    {
+        uint32_t bank_num = get_bank_num(header.prg.size(), bank_size_exp, 
+            prg_block_size_exp);
+        return access_rom(header.prg, bank, bank_num, bank_size_exp, 
+            prg_block_size_exp, sub_addr);
     }
 
-    virtual uint8_t& pt_access(Shared_Bus& shared_bus, uint16_t addr) = 0;
+    uint8_t& access_chr(uint32_t bank, uint32_t sub_addr, 
+            unsigned int bank_size_exp)
+    {
+        uint32_t bank_num = get_bank_num(header.chr.size(), bank_size_exp, 
+            chr_block_size_exp);
+        return access_rom(header.chr, bank, bank_num, bank_size_exp, 
+            chr_block_size_exp, sub_addr);
+    }
+
+    // To be invoked after every write to CHR memory
+    // Precondition: chr_byte is a byte of CHR memory
+    void update_decoded_row(Shared_Bus& shared_bus, const uint8_t& chr_byte)
+    {
+        // CHR-ROM (and hence its cache) may be shared with other cartridges
+        if(chr_cache.use_count() > 1)
+        {
+            chr_cache = std::make_shared<NES::Chr_Cache>(*chr_cache);
+            ppu_map_pages(shared_bus);
+        }
+        chr_cache->update(header.chr.front().data(), get_chr_offset(chr_byte));
+    }
+
+    // Gives this mapper a cache of its own unless CHR memory is ROM, so that
+    // a copy (see Mapper_Impl::clone()) doesn't share a cache being written
+    void unshare_chr_cache()
+    {
+        if(!header.has_chr_rom)
+            chr_cache = std::make_shared<NES::Chr_Cache>(*chr_cache);
+    }
+
+    // Which 1KB of nametable memory (0-1: CIRAM, 2-3: nt_ram) each
+    // nametable is, by mirroring (see
+    // https://wiki.nesdev.com/w/index.php/Mirroring#Nametable_Mirroring)
+    void set_mirroring(uint8_t mirroring)
+    {
+        constexpr uint8_t layouts[Mirroring::NUM][4] =
+        {
+            { 0, 0, 1, 1 },     // HORIZONTAL
+            { 0, 1, 0, 1 },     // VERTICAL
+            { 0, 0, 0, 0 },     // SINGLE_LOWER
+            { 1, 1, 1, 1 },     // SINGLE_UPPER
+            { 0, 1, 2, 3 }      // FOUR_SCREEN
+        };
+        for(unsigned int i = 0; i < 4; ++i)
+            nt_pages[i] = layouts[mirroring][i];
+    }
+
+    // Maps the 1KB pattern table pages from first_page onwards to page_num
+    // consecutive pages of CHR memory from chr_offset onwards
+    // Precondition: chr_offset is a multiple of 0x400 and within CHR memory
+    void map_chr_pages(unsigned int first_page, unsigned int page_num,
+                       uint32_t chr_offset)
+    {
+        for(unsigned int i = 0; i < page_num; ++i)
+            chr_pages[first_page + i] = chr_offset + (i << 10);
+    }
+
+    // Must return bytes of CHR memory; by default, through the page mapping
+    virtual uint8_t& pt_access(Shared_Bus&, uint16_t addr)
+    {
+        uint8_t* chr = header.chr.front().data();
+        return chr[chr_pages[addr >> 10] | (addr % 0x400)];
+    }
 
     virtual uint8_t& nt_access(Shared_Bus& shared_bus, uint16_t addr)
     {
-        uint16_t nt_mask = 1U << (header.mirror_vertical ? 10 : 11);
-        uint16_t ci_bit = ((addr & nt_mask) ? 1U : 0U) << 10;
-        uint16_t ci_subaddr = (addr & ~(0xFFFFU << 10));
-        return shared_bus.ciram[ci_bit | ci_subaddr];
+        return get_nt_page(shared_bus, addr >> 10)[addr % 0x400];
     }
 
     uint8_t& ppu_access(Shared_Bus& shared_bus, uint16_t addr)
     {
-        uint16_t sub_addr = (addr & ~(0xFFFFU << 13));
         return (((addr & (1U << 13)) == 0)
             ? pt_access(shared_bus, addr & ~(0xFFFFU << 13))
             : nt_access(shared_bus, addr & ~(0xFFFFU << 12)));
     }
 
   public:
-    Mapper(const Header& header) : header(header) {}
+    Mapper(const Header& header) 
+        : header(header), 
+          chr_cache(this->header.chr_cache
+                    ? std::move(this->header.chr_cache)
+                    : std::make_shared<NES::Chr_Cache>(
+                          header.chr.front().data(),
+                          header.chr.size() * chr_block_size))
+    {
+        map_chr_pages(0, 8, 0);
+        set_mirroring(header.mirror_alt_mode ? Mirroring::FOUR_SCREEN :
+                      header.mirror_vertical ? Mirroring::VERTICAL :
+                                               Mirroring::HORIZONTAL);
+    }
+
+    // By default, every cartridge access goes through cpu_read()/cpu_write()
+    void cpu_map_pages(Shared_Bus&) override {}
 
     uint8_t ppu_read(Shared_Bus& shared_bus, uint16_t addr) override
     {
@@ -93,6 +216,31 @@ class Mapper : public NES::Cartridge
     {
         uint8_t& dst = ppu_access(shared_bus, addr);
         dst = data;
+        if((addr & (1U << 13)) == 0) update_decoded_row(shared_bus, dst);
+    }
+
+    // Pattern table pages are mapped for reading only, so that CHR writes
+    // still go through ppu_write() and keep the decoded rows up to date
+    void ppu_map_pages(Shared_Bus& shared_bus) override
+    {
+        uint8_t* chr = header.chr.front().data();
+        for(unsigned int i = 0; i < 8; ++i)
+        {
+            shared_bus.ppu_page_read [i] = chr + chr_pages[i];
+            shared_bus.ppu_page_write[i] = nullptr;
+            shared_bus.ppu_row_page  [i] = chr_cache->get_rows(chr_pages[i]);
+        }
+
+        // $3000-$3EFF mirrors $2000-$2EFF
+        for(unsigned int i = 0; i < 4; ++i)
+        {
+            uint8_t* nt = get_nt_page(shared_bus, i);
+            for(unsigned int base : { 0x8U, 0xCU })
+            {
+                shared_bus.ppu_page_read [base + i] = nt;
+                shared_bus.ppu_page_write[base + i] = nt;
+            }
+        }
     }
 };
 
@@ -8,13 +8,16 @@
 #include "shared_bus.h"
 
 // NROM
-class Mapper00 : public Mapper_Impl<14, 13>
+class Mapper00 final : public Mapper_Impl<Mapper00, 14, 13>
 {
   private:
     uint8_t prg_ram[0x2000];
 
   public:
-    Mapper00(const Header& header) : Mapper_Impl(header) {}
+    Mapper00(const Header& header) : Mapper_Impl(header)
+    {
+        map_chr_bank(0, 0);
+    }
 
     uint8_t cpu_read(Shared_Bus&, uint16_t addr) override
     {
@@ -33,9 +36,11 @@ class Mapper00 : public Mapper_Impl<14, 13>
             prg_ram[addr % 0x2000] = data;
     }
 
-    uint8_t& pt_access(Shared_Bus& shared_bus, uint16_t addr) override
+    void cpu_map_pages(Shared_Bus& shared_bus) override
     {
-        return access_chr(0, addr);
+        shared_bus.map_cpu_pages(0x60, 0x20, prg_ram, prg_ram);
+        shared_bus.map_cpu_pages(0x80, 0x40, &access_prg(0, 0), nullptr);
+        shared_bus.map_cpu_pages(0xC0, 0x40, &access_prg(1, 0), nullptr);
     }
 };
 
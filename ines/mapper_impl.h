@@ -1,25 +1,80 @@
 #ifndef  MAPPER_IMPL_H_NOS
 #define  MAPPER_IMPL_H_NOS
 
+#include <cstdint>
+#include <memory>
 #include <stdexcept>
 
 #include "header.h"
 #include "mapper.h"
 
-template<unsigned int PRG_BSE, unsigned int CHR_BSE, 
+// Derived is the (final) mapper class itself, so that bank and pattern
+// table/nametable accesses resolve statically; a Basic_Console<Derived> then
+// reaches the mapper without any virtual call
+template<class Derived, unsigned int PRG_BSE, unsigned int CHR_BSE, 
     unsigned int PRG_BNUM_MIN = 1>
 class Mapper_Impl : public Mapper
 {
+  private:
+    uint8_t& ppu_access(Shared_Bus& shared_bus, uint16_t addr)
+    {
+        Derived& mapper = static_cast<Derived&>(*this);
+        return (((addr & (1U << 13)) == 0)
+            ? mapper.pt_access(shared_bus, addr & ~(0xFFFFU << 13))
+            : mapper.nt_access(shared_bus, addr & ~(0xFFFFU << 12)));
+    }
+
   protected:
     unsigned int get_prg_bank_size_exp() override final { return PRG_BSE; }
     unsigned int get_chr_bank_size_exp() override final { return CHR_BSE; }
 
+    uint8_t& access_prg(uint32_t bank, uint32_t sub_addr)
+    {
+        return Mapper::access_prg(bank, sub_addr, PRG_BSE);
+    }
+
+    uint8_t& access_chr(uint32_t bank, uint32_t sub_addr)
+    {
+        return Mapper::access_chr(bank, sub_addr, CHR_BSE);
+    }
+
+    // Maps the given CHR bank into the slot-th CHR_BSE-sized window of the
+    // pattern tables
+    // Precondition: CHR_BSE >= 10
+    void map_chr_bank(unsigned int slot, uint32_t bank)
+    {
+        constexpr unsigned int page_num = 1U << (CHR_BSE - 10);
+        map_chr_pages(slot * page_num, page_num,
+                      (bank % get_chr_bank_num()) << CHR_BSE);
+    }
+
   public:
     Mapper_Impl(const Header& header) : Mapper(header)
     {
         if(get_prg_bank_num() < PRG_BNUM_MIN)
             throw std::runtime_error("Not enough PRG-ROM");
     }
+
+    uint8_t ppu_read(Shared_Bus& shared_bus, uint16_t addr) override final
+    {
+        return ppu_access(shared_bus, addr);
+    }
+
+    void ppu_write(Shared_Bus& shared_bus, uint16_t addr, uint8_t data) 
+        override final
+    {
+        uint8_t& dst = ppu_access(shared_bus, addr);
+        dst = data;
+        if((addr & (1U << 13)) == 0) update_decoded_row(shared_bus, dst);
+    }
+
+    std::unique_ptr<NES::Cartridge> clone() const override
+    {
+        auto copy = std::make_unique<Derived>(
+            static_cast<const Derived&>(*this));
+        copy->unshare_chr_cache();
+        return copy;
+    }
 };
 
 #endif //MAPPER_IMPL_H_NOS
@@ -1,12 +1,18 @@
 #include <cstdint>      // uint8_t, uint32_t
 #include <vector>
+#include <algorithm>    // fill
 
 #include <fstream>
 #include <iterator>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <memory>       // unique_ptr, make_unique
 
 #include "console.h"
+#include "rate_control.h"
 #include "SDL.h"
 #include "sdl_aux.h"
 #include "ines.h"
@@ -15,102 +21,109 @@ using namespace NES;
 
 using std::vector;
 
+#ifdef NOS_CPU_AOT
+#ifdef NOS_STATIC_MAPPERS
+#error "NOS_CPU_AOT blocks are compiled against the generic CPU; \
+build without NOS_STATIC_MAPPERS"
+#endif
+// Defined by the translation unit generated for the ROM by aot/nos-aot
+extern const CPU::Compiled_Block aot_blocks[];
+extern const size_t aot_block_num;
+#endif
+
 static constexpr size_t sample_rate = 44100;
-static constexpr size_t frame_rate = 60;
-
-//Precondition: for each uint8_t val in src, val < 0x40
-void convert_framebuf(const uint8_t (&src)[pixel_quantity], 
-                           uint32_t (&dst)[pixel_quantity])
-{
-    static constexpr uint32_t palette_table[0x40] = 
-    {
-        0xFF545454, 0xFF001E74, 0xFF081090, 0xFF300088,
-        0xFF440064, 0xFF5C0030, 0xFF540400, 0xFF3C1800,
-        0xFF202A00, 0xFF083A00, 0xFF004000, 0xFF003C00,
-        0xFF00323C, 0xFF000000, 0xFF000000, 0xFF000000,
-        0xFF989698, 0xFF084CC4, 0xFF3032EC, 0xFF5C1EE4,
-        0xFF8814B0, 0xFFA01464, 0xFF982220, 0xFF783C00,
-        0xFF545A00, 0xFF287200, 0xFF087C00, 0xFF007628,
-        0xFF006678, 0xFF000000, 0xFF000000, 0xFF000000,
-        0xFFECEEEC, 0xFF4C9AEC, 0xFF787CEC, 0xFFB062EC,
-        0xFFE454EC, 0xFFEC58B4, 0xFFEC6A64, 0xFFD48820,
-        0xFFA0AA00, 0xFF74C400, 0xFF4CD020, 0xFF38CC6C,
-        0xFF38B4CC, 0xFF3C3C3C, 0xFF000000, 0xFF000000,
-        0xFFECEEEC, 0xFFA8CCEC, 0xFFBCBCEC, 0xFFD4B2EC,
-        0xFFECAEEC, 0xFFECAED4, 0xFFECB4B0, 0xFFE4C490,
-        0xFFCCD278, 0xFFB4DE78, 0xFFA8E290, 0xFF98E2B4,
-        0xFFA0D6E4, 0xFFA0A2A0, 0xFF000000, 0xFF000000 
-    };
+// Pulled by the audio device at a time (about 12ms)
+static constexpr size_t audio_buffer_samples = 512;
 
-    for(unsigned int i = 0; i < pixel_quantity; ++i)
-    {
-        dst[i] = palette_table[src[i]];
-    }
+vector<uint8_t> load_file(const char* path)
+{
+    std::ifstream input(path, std::ios::binary | std::ios::in);
+    input >> std::noskipws;
+    return vector<uint8_t>(std::istream_iterator<uint8_t>(input), {});
 }
 
-// Precondition: dst_len < src_len
-void resample_audio(const float* src, const size_t src_len,  
-                          float* dst, const size_t dst_len)
+void attach_compiled_code(Console& console)
 {
-    double sum = 0;
-    size_t samples_src_per_dst = 0;
-    size_t num = 0;
-    
-    size_t dst_i = 0;
-
-    for(size_t src_i = 0; src_i < src_len; ++src_i)
-    {
-        sum += src[src_i];
-        ++samples_src_per_dst;
-        num += dst_len;
-        
-        if(num >= src_len)
-        {
-            dst[dst_i++] = (sum / samples_src_per_dst);
+#ifdef NOS_CPU_AOT
+    console.cpu.attach_compiled_code(aot_blocks, aot_block_num);
+#else
+    (void)console;
+#endif
+}
 
-            sum = 0;
-            samples_src_per_dst = 0;
-            num -= src_len;
-        }
-    }
+std::unique_ptr<Console_Base> load_console(const vector<uint8_t>& rom)
+{
+#ifdef NOS_CPU_AOT
+    auto console = std::make_unique<Console>(load_ines(rom));
+    attach_compiled_code(*console);
+    return console;
+#else
+    return load_ines_console(rom);
+#endif
 }
 
-vector<uint8_t> load_file(const char* path)
+// Audio callback draining the console's sample ring; whatever the core hasn't
+// produced yet is played as silence
+void pull_audio(void* userdata, Uint8* stream, int len)
 {
-    std::ifstream input(path, std::ios::binary | std::ios::in);
-    input >> std::noskipws;
-    return vector<uint8_t>(std::istream_iterator<uint8_t>(input), {});
+    auto& ring = *static_cast<Shared_Bus::Sample_Ring*>(userdata);
+    float* dst = reinterpret_cast<float*>(stream);
+    size_t num = len / sizeof(float);
+
+    size_t popped = ring.pop(dst, num);
+    std::fill(dst + popped, dst + num, 0.0f);
 }
 
 void run(const char* rom_filepath)
 {
     vector<uint8_t> rom = load_file(rom_filepath);
-    Console console(load_ines(rom));
+    std::unique_ptr<Console_Base> console_ptr = load_console(rom);
+    Console_Base& console = *console_ptr;
 
     uint32_t argb_framebuf[width_px * height_px];
-    size_t samples_out_per_frame = sample_rate / frame_rate;
-    float audio_out[samples_out_per_frame];
+    console.set_sample_rate(sample_rate);
+    console.set_audio_delivery(Audio_Delivery::SCANLINE);
+    Shared_Bus::Sample_Ring& audio_ring = console.get_audio_ring();
+
+    // Enough for the samples of a frame (produced at once while presenting
+    // frames waits for vsync) on top of a device buffer's worth. As samples
+    // are pulled a buffer at a time, while waiting on the device the fill
+    // level averages half a buffer below the maximum
+    size_t samples_per_frame = sample_rate / frame_rate_hz;
+    size_t audio_target_fill = samples_per_frame + audio_buffer_samples;
+    Rate_Control rate_control(audio_target_fill, 
+                              audio_target_fill + (audio_buffer_samples / 2));
     
     SDL_Aux::State io;
-    SDL_Aux::init(io, width_px, height_px, sample_rate);
+    SDL_Aux::init(io, width_px, height_px, sample_rate, audio_buffer_samples,
+                  pull_audio, &audio_ring);
     
     uint64_t frame_count = 0;
 
     do 
     {
+        // The audio device's clock paces emulation, whatever the display's
+        // refresh rate: nothing is emulated while the ring holds plenty
+        if(rate_control.is_ahead(audio_ring.size()))
+        {
+            SDL_Delay(1);
+            continue;
+        }
+
         console.exec();
 
         if(console.get_frame_count() != frame_count)
         {
-            convert_framebuf(console.get_framebuf(), argb_framebuf);
+            convert_to_argb8888(console.get_framebuf(), argb_framebuf, 
+                                pixel_quantity);
             SDL_Aux::render(io, argb_framebuf, width_px);
 
-            resample_audio(console.get_audiobuf(), max_samples_per_frame,
-                           audio_out,              samples_out_per_frame);
-            SDL_QueueAudio(io.audio_device, audio_out, sizeof(audio_out));
-                           
-
             frame_count = console.get_frame_count();
+
+            // Keep the ring near its target despite the display running
+            // slightly slower or faster than the NES (by up to 0.5%)
+            double rate_ratio = rate_control.update(audio_ring.size());
+            console.set_audio_rate_ratio(rate_ratio);
             
             SDL_PumpEvents();
             using B = Controller::Button;
@@ -127,10 +140,643 @@ void run(const char* rom_filepath)
     while(!(io.kb_state[SDL_SCANCODE_ESCAPE]));
 
     SDL_Aux::quit(io);
+
+    std::cout << "audio samples:  " << audio_ring.get_starved_num() 
+              << " starved, " << audio_ring.get_dropped_num() << " dropped\n"
+              << "audio fill:     " << rate_control.get_min_fill() << " min, "
+              << rate_control.get_target_fill() << " target, "
+              << rate_control.get_max_fill() << " max\n"
+              << "audio ratio:    " << rate_control.get_min_ratio() << " min, "
+              << rate_control.get_max_ratio() << " max, "
+              << rate_control.get_ratio() << " last\n"
+              << "pacing waits:   " << rate_control.get_wait_num() << "\n";
+}
+
+// Headless benchmark of the emulator core (no SDL involved)
+void bench(const char* rom_filepath, uint64_t frames)
+{
+    vector<uint8_t> rom = load_file(rom_filepath);
+    std::unique_ptr<Console_Base> console_ptr = load_console(rom);
+    Console_Base& console = *console_ptr;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while(console.get_frame_count() < frames)
+        console.exec();
+
+    uint64_t instr_count = console.get_instruction_count();
+    uint64_t scanln_count = console.get_scanln_count();
+    uint64_t fast_scanln_count = console.get_fast_scanln_count();
+
+    std::chrono::duration<double> elapsed = 
+        std::chrono::steady_clock::now() - start;
+
+#if defined(NOS_CPU_JIT)
+    const char* dispatch = "jit";
+#elif defined(NOS_CPU_AOT)
+    const char* dispatch = "aot";
+#elif defined(NOS_CPU_SWITCH_DISPATCH)
+    const char* dispatch = "switch";
+#else
+    const char* dispatch = "table";
+#endif
+#ifdef NOS_STATIC_MAPPERS
+    const char* mappers = "static";
+#else
+    const char* mappers = "virtual";
+#endif
+    std::cout << "dispatch:       " << dispatch << "\n"
+              << "mappers:        " << mappers << "\n"
+              << "frames:         " << frames << "\n"
+              << "seconds:        " << elapsed.count() << "\n"
+              << "instructions/s: " << (instr_count / elapsed.count()) << "\n"
+              << "frames/s:       " << (frames / elapsed.count()) << "\n"
+              << "scanlines:      " << fast_scanln_count << " fast, "
+              << (scanln_count - fast_scanln_count) << " per-dot\n";
+}
+
+// Resident set size of the process in KB (0 where /proc isn't available)
+size_t get_rss_kb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string field;
+    while(status >> field)
+    {
+        size_t kb = 0;
+        if((field == "VmRSS:") && (status >> kb)) return kb;
+    }
+
+    return 0;
+}
+
+// Constructs the given number of consoles for the ROM, all kept alive at
+// once (as when hosting many in one process), and reports the average time
+// and resident memory each one takes
+void constructbench(const char* rom_filepath, uint64_t count)
+{
+    vector<uint8_t> rom = load_file(rom_filepath);
+    vector<std::unique_ptr<Console_Base>> consoles;
+    consoles.reserve(count);
+
+    size_t start_rss_kb = get_rss_kb();
+    auto start = std::chrono::steady_clock::now();
+
+    for(uint64_t i = 0; i < count; ++i)
+        consoles.push_back(load_console(rom));
+
+    std::chrono::duration<double> elapsed = 
+        std::chrono::steady_clock::now() - start;
+    size_t rss_kb = get_rss_kb() - start_rss_kb;
+
+    std::cout << "consoles:       " << count << "\n"
+              << "us/console:     " << (elapsed.count() * 1e6 / count) << "\n"
+              << "KB/console:     " << (double(rss_kb) / count) << "\n";
+}
+
+// Runs two consoles of the ROM side by side a frame at a time: setup(fst,
+// snd) configures them beforehand, on_frame(fst, snd, frame) follows each
+// frame (e.g. requesting skips of the next one), and is_match(fst, snd) then
+// compares them; reports the first mismatch
+template<class Setup, class On_Frame, class Is_Match>
+int run_side_by_side(const char* rom_filepath, uint64_t frames, Setup setup,
+                     On_Frame on_frame, Is_Match is_match)
+{
+    vector<uint8_t> rom = load_file(rom_filepath);
+    Console fst(load_ines(rom));
+    Console snd(load_ines(rom));
+    setup(fst, snd);
+
+    while(fst.get_frame_count() < frames)
+    {
+        uint64_t frame = fst.get_frame_count();
+        while(fst.get_frame_count() == frame)
+            fst.exec();
+        while(snd.get_frame_count() == frame)
+            snd.exec();
+
+        on_frame(fst, snd, frame);
+        if(!is_match(fst, snd))
+        {
+            std::cout << "mismatch (frame " << fst.get_frame_count()
+                      << ")\n";
+            return 1;
+        }
+    }
+
+    std::cout << "match: " << frames << " frames\n";
+    return 0;
 }
 
+// Runs the ROM with frame skipping (3 out of every 4 frames, plus on-demand
+// skips) alongside a full render, comparing CPU state and work RAM after
+// every frame
+int skipcheck(const char* rom_filepath, uint64_t frames)
+{
+    auto setup = [](Console&, Console& skipped)
+    {
+        skipped.set_frame_skip(3, 4);
+    };
+    auto on_frame = [](Console&, Console& skipped, uint64_t frame)
+    {
+        // Only one frame in 4 is rendered otherwise; skip some of those too
+        if(frame % 12 == 3)
+            skipped.skip_next_frame();
+    };
+    auto is_match = [](Console& full, Console& skipped)
+    {
+        const uint8_t* full_ram = full.shared_bus.cpu_page_read[0x00];
+        const uint8_t* skipped_ram = skipped.shared_bus.cpu_page_read[0x00];
+        return (full.cpu.get_state() == skipped.cpu.get_state()) &&
+               (std::memcmp(full_ram, skipped_ram, 0x800) == 0);
+    };
+    return run_side_by_side(rom_filepath, frames, setup, on_frame, is_match);
+}
+
+// Runs the ROM with pixels generated on a worker thread alongside a
+// single-threaded console (with on-demand frame skips in both), comparing the
+// latest frame of each after every frame
+int deferredcheck(const char* rom_filepath, uint64_t frames)
+{
+    auto setup = [](Console&, Console& deferred)
+    {
+        deferred.enable_deferred_rendering();
+    };
+    auto on_frame = [](Console& direct, Console& deferred, uint64_t frame)
+    {
+        if(frame % 7 == 3)
+        {
+            direct.skip_next_frame();
+            deferred.skip_next_frame();
+        }
+    };
+    auto is_match = [](Console& direct, Console& deferred)
+    {
+        deferred.wait_for_rendering();
+        return (std::memcmp(direct.get_framebuf(), deferred.get_framebuf(),
+                            sizeof(uint16_t) * pixel_quantity) == 0);
+    };
+    return run_side_by_side(rom_filepath, frames, setup, on_frame, is_match);
+}
+
+// Runs the ROM with idle loop skipping alongside a console executing every
+// iteration, comparing CPU state, work RAM and the latest frame after every
+// frame (which --lockstep can't, as both of its consoles skip)
+int idlecheck(const char* rom_filepath, uint64_t frames)
+{
+    auto setup = [](Console& executed, Console&)
+    {
+        executed.cpu.set_idle_loop_skipping(false);
+    };
+    // Either may notice the end of a frame some instructions later (e.g. when
+    // it was in a loop skipped, or in a block of compiled code), so compare
+    // them once they've executed the same instructions
+    auto on_frame = [](Console& executed, Console& skipped, uint64_t)
+    {
+        while(executed.cpu.get_instruction_count() !=
+                 skipped.cpu.get_instruction_count())
+        {
+            if(executed.cpu.get_instruction_count() <
+                  skipped.cpu.get_instruction_count())
+                executed.exec();
+            else
+                skipped.exec();
+        }
+    };
+    auto is_match = [](Console& executed, Console& skipped)
+    {
+        const uint8_t* executed_ram = executed.shared_bus.cpu_page_read[0x00];
+        const uint8_t* skipped_ram = skipped.shared_bus.cpu_page_read[0x00];
+        return (executed.cpu.get_state() == skipped.cpu.get_state()) &&
+               (std::memcmp(executed_ram, skipped_ram, 0x800) == 0) &&
+               (std::memcmp(executed.get_framebuf(), skipped.get_framebuf(),
+                            sizeof(uint16_t) * pixel_quantity) == 0);
+    };
+    return run_side_by_side(rom_filepath, frames, setup, on_frame, is_match);
+}
+
+void print_state(const char* name, const CPU::State& state)
+{
+    std::cout << std::hex 
+              << name << ": A=" << +state.A << " X=" << +state.X 
+              << " Y=" << +state.Y << " PS=" << +state.PS 
+              << " SP=" << +state.SP << " PC=" << state.PC << std::dec
+              << " cycle=" << state.cycle_count 
+              << " instr=" << state.instr_count << "\n";
+}
+
+// Eager reference for flagcheck(): executes one instruction at PC, with the
+// architectural effects only, on registers and memory of its own (work RAM,
+// and 16KB of PRG-ROM at $8000-$FFFF), assigning N/Z/C/V within PS as each
+// instruction produces them
+struct Reference_CPU
+{
+    uint8_t A, X, Y, PS, SP;
+    uint16_t PC;
+    uint8_t ram[0x800];
+    const uint8_t* prg;
+
+    uint8_t read(uint16_t addr)
+    {
+        if(addr < 0x2000)  return ram[addr % 0x800];
+        if(addr >= 0x8000) return prg[addr % 0x4000];
+        return 0;
+    }
+
+    void write(uint16_t addr, uint8_t data)
+    {
+        if(addr < 0x2000) ram[addr % 0x800] = data;
+    }
+
+    void push(uint8_t data) { write(0x100 | SP--, data); }
+    uint8_t pull() { return read(0x100 | ++SP); }
+
+    void set_flag(uint8_t flag, bool is_set)
+    {
+        PS = (is_set ? (PS | flag) : (PS & ~flag));
+    }
+
+    void set_zn(uint8_t data)
+    {
+        set_flag(PS_Flags::ZERO, data == 0);
+        set_flag(PS_Flags::NEGATIVE, data & (1U << 7));
+    }
+
+    void add(uint8_t data)
+    {
+        unsigned int sum = A + data + ((PS & PS_Flags::CARRY) ? 1 : 0);
+        set_flag(PS_Flags::OVERFLOW, ~(A ^ data) & (A ^ sum) & (1U << 7));
+        set_flag(PS_Flags::CARRY, sum > 0xFF);
+        A = uint8_t(sum);
+        set_zn(A);
+    }
+
+    void compare(uint8_t reg, uint8_t data)
+    {
+        set_flag(PS_Flags::CARRY, reg >= data);
+        set_zn(reg - data);
+    }
+
+    void exec()
+    {
+        Opcode_Info info = opcode_info[read(PC)];
+        AddrMode am = info.addr_mode;
+        uint8_t lsb = read(PC + 1);
+        uint16_t word = (read(PC + 2) << 8) | lsb;
+        PC += 1 + operand_size(am);
+
+        auto read_pointer = [&](uint16_t addr)
+        {
+            // The msb comes from the same page (zero page for InX/InY)
+            uint16_t next = (addr & 0xFF00) | uint8_t(addr + 1);
+            return uint16_t((read(next) << 8) | read(addr));
+        };
+
+        uint16_t addr = 0;
+        switch(am)
+        {
+            case(ZP):   addr = lsb;                             break;
+            case(ZPX):  addr = uint8_t(lsb + X);                break;
+            case(ZPY):  addr = uint8_t(lsb + Y);                break;
+            case(InX):  addr = read_pointer(uint8_t(lsb + X));  break;
+            case(InY):
+            case(InYS): addr = read_pointer(lsb) + Y;           break;
+            case(Ab):   addr = word;                            break;
+            case(AbX):
+            case(AbXS): addr = word + X;                        break;
+            case(AbY):
+            case(AbYS): addr = word + Y;                        break;
+            case(In):   addr = read_pointer(word);              break;
+            default:                                            break;
+        }
+
+        auto load = [&]() -> uint8_t
+        {
+            return ((am == Imm) ? lsb : (am == Acc) ? A : read(addr));
+        };
+        auto store = [&](uint8_t data)
+        {
+            if(am == Acc) A = data;
+            else          write(addr, data);
+        };
+        auto branch = [&](bool condition)
+        {
+            if(condition) PC += int8_t(lsb);
+        };
+
+        // Read-modify-write operations, returning the result
+        auto shift_left = [&](bool carry_in)
+        {
+            uint8_t data = load();
+            uint8_t result = (data << 1) | (carry_in ? 1 : 0);
+            set_flag(PS_Flags::CARRY, data & (1U << 7));
+            set_zn(result);
+            store(result);
+            return result;
+        };
+        auto shift_right = [&](bool carry_in)
+        {
+            uint8_t data = load();
+            uint8_t result = (data >> 1) | (carry_in ? (1U << 7) : 0);
+            set_flag(PS_Flags::CARRY, data & (1U << 0));
+            set_zn(result);
+            store(result);
+            return result;
+        };
+        auto increment = [&](int delta)
+        {
+            uint8_t result = load() + delta;
+            set_zn(result);
+            store(result);
+            return result;
+        };
+
+        bool carry = (PS & PS_Flags::CARRY);
+        switch(info.instr)
+        {
+            case(ADC): add(load());                                     break;
+            case(SBC): add(load() ^ 0xFF);                              break;
+            case(AND): A &= load(); set_zn(A);                          break;
+            case(ORA): A |= load(); set_zn(A);                          break;
+            case(EOR): A ^= load(); set_zn(A);                          break;
+            case(CMP): compare(A, load());                              break;
+            case(CPX): compare(X, load());                              break;
+            case(CPY): compare(Y, load());                              break;
+            case(INC): increment(1);                                    break;
+            case(DEC): increment(-1);                                   break;
+            case(ASL): shift_left(false);                               break;
+            case(ROL): shift_left(carry);                               break;
+            case(LSR): shift_right(false);                              break;
+            case(ROR): shift_right(carry);                              break;
+
+            case(BPL): branch(!(PS & PS_Flags::NEGATIVE));              break;
+            case(BMI): branch( (PS & PS_Flags::NEGATIVE));              break;
+            case(BVC): branch(!(PS & PS_Flags::OVERFLOW));              break;
+            case(BVS): branch( (PS & PS_Flags::OVERFLOW));              break;
+            case(BCC): branch(!(PS & PS_Flags::CARRY));                 break;
+            case(BCS): branch( (PS & PS_Flags::CARRY));                 break;
+            case(BNE): branch(!(PS & PS_Flags::ZERO));                  break;
+            case(BEQ): branch( (PS & PS_Flags::ZERO));                  break;
+
+            case(JMP): PC = addr;                                       break;
+            case(JSR):
+                push((PC - 1) >> 8);
+                push((PC - 1) % 0x100);
+                PC = addr;
+                break;
+            case(RTS):
+                PC = pull();
+                PC = (PC | (pull() << 8)) + 1;
+                break;
+            case(BRK):
+                ++PC;
+                push(PC >> 8);
+                push(PC % 0x100);
+                push(PS | PS_Flags::UNUSED | PS_Flags::BREAK);
+                PS |= PS_Flags::IRQ_DISABLE;
+                PC = (read(IV_Addr::IRQ + 1) << 8) | read(IV_Addr::IRQ);
+                break;
+            case(RTI):
+                PS = pull() & ~(PS_Flags::UNUSED | PS_Flags::BREAK);
+                PC = pull();
+                PC |= (pull() << 8);
+                break;
+
+            case(CLC): PS &= ~PS_Flags::CARRY;                          break;
+            case(SEC): PS |=  PS_Flags::CARRY;                          break;
+            case(CLD): PS &= ~PS_Flags::DECIMAL;                        break;
+            case(SED): PS |=  PS_Flags::DECIMAL;                        break;
+            case(CLI): PS &= ~PS_Flags::IRQ_DISABLE;                    break;
+            case(SEI): PS |=  PS_Flags::IRQ_DISABLE;                    break;
+            case(CLV): PS &= ~PS_Flags::OVERFLOW;                       break;
+            case(BIT):
+            {
+                uint8_t data = load();
+                set_flag(PS_Flags::ZERO, (data & A) == 0);
+                set_flag(PS_Flags::NEGATIVE, data & (1U << 7));
+                set_flag(PS_Flags::OVERFLOW, data & (1U << 6));
+                break;
+            }
+
+            case(TAX): X = A; set_zn(X);                                break;
+            case(TAY): Y = A; set_zn(Y);                                break;
+            case(TXA): A = X; set_zn(A);                                break;
+            case(TYA): A = Y; set_zn(A);                                break;
+            case(TSX): X = SP; set_zn(X);                               break;
+            case(TXS): SP = X;                                          break;
+            case(DEX): set_zn(--X);                                     break;
+            case(DEY): set_zn(--Y);                                     break;
+            case(INX): set_zn(++X);                                     break;
+            case(INY): set_zn(++Y);                                     break;
+            case(LDA): A = load(); set_zn(A);                           break;
+            case(LDX): X = load(); set_zn(X);                           break;
+            case(LDY): Y = load(); set_zn(Y);                           break;
+            case(STA): store(A);                                        break;
+            case(STX): store(X);                                        break;
+            case(STY): store(Y);                                        break;
+
+            case(PHA): push(A);                                         break;
+            case(PLA): A = pull(); set_zn(A);                           break;
+            case(PHP): push(PS | PS_Flags::UNUSED | PS_Flags::BREAK);   break;
+            case(PLP):
+                PS = pull() & ~(PS_Flags::UNUSED | PS_Flags::BREAK);
+                break;
+
+            case(SLO): A |= shift_left(false); set_zn(A);               break;
+            case(RLA): A &= shift_left(carry); set_zn(A);               break;
+            case(SRE): A ^= shift_right(false); set_zn(A);              break;
+            case(RRA): add(shift_right(carry));                         break;
+            case(SAX): store(A & X);                                    break;
+            case(LAX): A = X = load(); set_zn(A);                       break;
+            case(DCP): compare(A, increment(-1));                       break;
+            case(ISC): add(increment(1) ^ 0xFF);                        break;
+
+            // NOP, STP, and the unofficial instructions the CPU leaves
+            // unimplemented (which only perform their addressing)
+            default:                                                    break;
+        }
+    }
+};
+
+// Runs every opcode, through the CPU and through Reference_CPU, on inputs
+// covering each flag's edge cases (values of A, memory operand, flags, index
+// registers and SP), comparing the registers, PS as materialized by the CPU,
+// and work RAM after each; every operand address lands in work RAM, and the
+// instruction itself executes from it
+int flagcheck()
+{
+    // NROM with 16KB of PRG-ROM (mirrored at $8000 and $C000) and CHR-RAM;
+    // every vector points to $9234
+    vector<uint8_t> rom(0x10 + 0x4000, 0);
+    const uint8_t ines_header[] = { 0x4E, 0x45, 0x53, 0x1A, 1, 0 };
+    std::memcpy(rom.data(), ines_header, sizeof(ines_header));
+    uint8_t* prg = rom.data() + 0x10;
+    for(uint16_t vector_addr : { IV_Addr::NMI, IV_Addr::RESET, IV_Addr::IRQ })
+    {
+        prg[(vector_addr + 0) % 0x4000] = 0x34;
+        prg[(vector_addr + 1) % 0x4000] = 0x92;
+    }
+
+    Console console(load_ines(rom));
+    auto set_ram = [&console](const uint8_t* src)
+    {
+        for(unsigned int page = 0; page < 0x8; ++page)
+            std::memcpy(console.shared_bus.cpu_page_write[page],
+                        src + (page << 8), 0x100);
+    };
+    auto is_ram_equal = [&console](const uint8_t* other)
+    {
+        for(unsigned int page = 0; page < 0x8; ++page)
+            if(std::memcmp(console.shared_bus.cpu_page_read[page],
+                           other + (page << 8), 0x100) != 0)
+                return false;
+        return true;
+    };
+
+    // The APU's frame IRQ would be serviced whenever a case clears I:
+    // LDA #$40, STA $4017
+    Reference_CPU ref = {};
+    ref.prg = prg;
+    const uint8_t inhibit_irq[] = { 0xA9, 0x40, 0x8D, 0x17, 0x40 };
+    std::memcpy(ref.ram + 0x300, inhibit_irq, sizeof(inhibit_irq));
+    set_ram(ref.ram);
+    CPU::State setup = { 0, 0, 0, PS_Flags::IRQ_DISABLE, 0xFF, 0x300, 0, 0 };
+    console.cpu.set_state(setup);
+    console.exec();
+    console.exec();
+
+    const uint8_t values[] = { 0x00, 0x01, 0x40, 0x7F, 0x80, 0x81, 0xC0, 0xFF };
+    // X, Y and SP, including wraparounds and page crossings
+    const uint8_t index_sets[][3] =
+        { { 0x00, 0x00, 0xFF }, { 0x01, 0x80, 0x80 }, { 0xFF, 0xFF, 0x00 } };
+    constexpr uint8_t flag_bits =
+        PS_Flags::CARRY    | PS_Flags::ZERO     | PS_Flags::IRQ_DISABLE |
+        PS_Flags::DECIMAL  | PS_Flags::OVERFLOW | PS_Flags::NEGATIVE;
+
+    uint64_t case_num = 0;
+    for(unsigned int opcode = 0; opcode < 0x100; ++opcode)
+    for(uint8_t a : values)
+    for(uint8_t data : values)
+    for(const uint8_t* index : index_sets)
+    for(unsigned int flags = 0; flags < 0x100; ++flags)
+    {
+        if(flags & ~flag_bits)
+            continue;
+
+        // The operand (M) everywhere an instruction may read it, except for
+        // the pointers at $0004 of the indirect modes in zero page; operands
+        // address $0080 (zero page) or $0480 (absolute)
+        AddrMode am = opcode_info[opcode].addr_mode;
+        bool is_indirect = ((am == InX) || (am == InY) || (am == InYS));
+        std::memset(ref.ram, data, sizeof(ref.ram));
+        std::memset(ref.ram, (is_indirect ? 0x04 : data), 0x100);
+        ref.ram[0x300] = opcode;
+        ref.ram[0x301] = ((am == Imm) ? data : 0x80);
+        ref.ram[0x302] = 0x04;
+        set_ram(ref.ram);
+
+        ref.A = a;
+        ref.X = index[0];
+        ref.Y = index[1];
+        ref.PS = flags;
+        ref.SP = index[2];
+        ref.PC = 0x300;
+        CPU::State input =
+            { ref.A, ref.X, ref.Y, ref.PS, ref.SP, ref.PC, 0, 0 };
+        console.cpu.set_state(input);
+
+        console.exec();
+        ref.exec();
+        ++case_num;
+
+        CPU::State state = console.cpu.get_state();
+        if((state.A != ref.A) || (state.X != ref.X) || (state.Y != ref.Y) ||
+           (state.PS != ref.PS) || (state.SP != ref.SP) ||
+           (state.PC != ref.PC) || !is_ram_equal(ref.ram))
+        {
+            CPU::State expected = { ref.A, ref.X, ref.Y, ref.PS, ref.SP,
+                                    ref.PC, state.cycle_count,
+                                    state.instr_count };
+            std::cout << std::hex << "mismatch (opcode " << opcode
+                      << ", M=" << +data << ")\n" << std::dec;
+            print_state("input    ", input);
+            print_state("cpu      ", state);
+            print_state("reference", expected);
+            return 1;
+        }
+    }
+
+    std::cout << "match: " << case_num << " cases\n";
+    return 0;
+}
+
+#ifdef NOS_CPU_COMPILED_CODE
+// Runs compiled code (JIT/AOT) alongside the interpreter, comparing CPU state,
+// work RAM and bus accesses with side effects after every compiled block
+int lockstep(const char* rom_filepath, uint64_t frames)
+{
+    vector<uint8_t> rom = load_file(rom_filepath);
+    Console compiled(load_ines(rom));
+    Console interp(load_ines(rom));
+
+    attach_compiled_code(compiled);
+    interp.cpu.set_compiled_code_enabled(false);
+    compiled.cpu.set_bus_traced(true);
+    interp.cpu.set_bus_traced(true);
+
+    while(compiled.get_frame_count() < frames)
+    {
+        compiled.exec();
+        while(interp.cpu.get_instruction_count() < 
+                 compiled.cpu.get_instruction_count())
+            interp.exec();
+
+        CPU::State compiled_state = compiled.cpu.get_state();
+        CPU::State interp_state = interp.cpu.get_state();
+        const uint8_t* compiled_ram = compiled.shared_bus.cpu_page_read[0x00];
+        const uint8_t* interp_ram = interp.shared_bus.cpu_page_read[0x00];
+        if((compiled_state != interp_state) ||
+           (compiled.cpu.get_bus_trace() != interp.cpu.get_bus_trace()) ||
+           (std::memcmp(compiled_ram, interp_ram, 0x800) != 0))
+        {
+            std::cout << "mismatch (frame " << compiled.get_frame_count() 
+                      << ")\n";
+            print_state("compiled", compiled_state);
+            print_state("interp  ", interp_state);
+            return 1;
+        }
+    }
+
+    std::cout << "match: " << frames << " frames, " 
+              << compiled.cpu.get_instruction_count() << " instructions\n";
+    return 0;
+}
+#endif
+
 int main(int argc, char** argv)
 {
+    if((argc == 4) && (std::strcmp(argv[1], "--bench") == 0))
+    {
+        bench(argv[2], std::strtoull(argv[3], nullptr, 10));
+        return 0;
+    }
+    if((argc == 4) && (std::strcmp(argv[1], "--constructbench") == 0))
+    {
+        constructbench(argv[2], std::strtoull(argv[3], nullptr, 10));
+        return 0;
+    }
+    if((argc == 4) && (std::strcmp(argv[1], "--skipcheck") == 0))
+        return skipcheck(argv[2], std::strtoull(argv[3], nullptr, 10));
+    if((argc == 4) && (std::strcmp(argv[1], "--deferredcheck") == 0))
+        return deferredcheck(argv[2], std::strtoull(argv[3], nullptr, 10));
+    if((argc == 4) && (std::strcmp(argv[1], "--idlecheck") == 0))
+        return idlecheck(argv[2], std::strtoull(argv[3], nullptr, 10));
+    if((argc == 2) && (std::strcmp(argv[1], "--flagcheck") == 0))
+        return flagcheck();
+#ifdef NOS_CPU_COMPILED_CODE
+    if((argc == 4) && (std::strcmp(argv[1], "--lockstep") == 0))
+        return lockstep(argv[2], std::strtoull(argv[3], nullptr, 10));
+#endif
+
     if(argc != 2) return 1;
     const char* rom_filepath = argv[1];
     
@@ -20,8 +20,11 @@ struct State
     SDL_AudioDeviceID audio_device;
 };
 
+// Audio is pulled by audio_callback (on SDL's audio thread), a buffer of
+// audio_buffer_samples at a time
 inline void init(State& state, unsigned int width, unsigned int height, 
-    int sample_rate)
+    int sample_rate, int audio_buffer_samples, 
+    SDL_AudioCallback audio_callback, void* audio_userdata)
 {
     auto init_fail = [](){ throw std::runtime_error("Failed to init SDL"); };
 
@@ -54,8 +57,9 @@ inline void init(State& state, unsigned int width, unsigned int height,
         .freq = sample_rate,
         .format = AUDIO_F32,
         .channels = 1,
-        .samples = 2048,
-        .callback = NULL
+        .samples = Uint16(audio_buffer_samples),
+        .callback = audio_callback,
+        .userdata = audio_userdata
     };
     SDL_AudioSpec dummy; // Unused, but required for SDL
     auto audio_device = SDL_OpenAudioDevice(NULL, 0, &audio_spec, &dummy, 